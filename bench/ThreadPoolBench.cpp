@@ -0,0 +1,98 @@
+/*
+ * SoftGLRender
+ * @author 	: keith@robot9.me
+ *
+ */
+
+// push-then-wait loop over the ThreadPool idle spin time, reports the wake up latency of a task
+// pushed after an idle gap and the cpu cores burned by the pool while waiting for it
+// usage: ThreadPoolBench [threadCnt]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <vector>
+
+#include "Base/ThreadPool.h"
+
+using namespace SoftGL;
+using Clock = std::chrono::steady_clock;
+
+struct BenchResult
+{
+    double latencyAvgUs = 0.0;
+    double latencyP99Us = 0.0;
+    double cpuCores = 0.0;
+};
+
+static BenchResult runBench(ThreadPool &pool, std::chrono::microseconds gap,
+                            std::chrono::milliseconds duration)
+{
+    std::vector<double> latencies;
+    Clock::time_point pushTime;
+    Clock::time_point startTime;
+
+    // process cpu time of all threads on POSIX
+    std::clock_t cpuStart = std::clock();
+    Clock::time_point wallStart = Clock::now();
+    while (Clock::now() - wallStart < duration)
+    {
+        // workers went idle during the gap, sleeping or spinning by the pool spin time
+        if (gap.count() > 0)
+        {
+            std::this_thread::sleep_for(gap);
+        }
+
+        pushTime = Clock::now();
+        pool.pushTask([&](std::size_t) { startTime = Clock::now(); });
+        pool.waitTasksFinish();
+        latencies.push_back(
+            std::chrono::duration<double, std::micro>(startTime - pushTime).count());
+    }
+    double wallSec = std::chrono::duration<double>(Clock::now() - wallStart).count();
+    double cpuSec = (double)(std::clock() - cpuStart) / CLOCKS_PER_SEC;
+
+    BenchResult ret;
+    std::sort(latencies.begin(), latencies.end());
+    for (double latency : latencies)
+    {
+        ret.latencyAvgUs += latency;
+    }
+    ret.latencyAvgUs /= (double)latencies.size();
+    ret.latencyP99Us = latencies[latencies.size() * 99 / 100];
+    ret.cpuCores = cpuSec / wallSec;
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    std::size_t threadCnt = std::thread::hardware_concurrency();
+    if (argc > 1)
+    {
+        threadCnt = std::max(std::atoi(argv[1]), 1);
+    }
+
+    const int spinTimes[] = {0, 10, 50, 200};
+    const int gaps[] = {0, 20, 200, 2000};
+    const std::chrono::milliseconds duration(300);
+
+    printf("threads %zu, cores %u, default spin %lld us\n", threadCnt,
+           std::thread::hardware_concurrency(),
+           (long long)ThreadPool::kDefaultIdleSpinTime.count());
+    printf("%8s %8s %12s %12s %10s\n", "spin us", "gap us", "latency us", "p99 us", "cpu cores");
+    for (int spin : spinTimes)
+    {
+        // set explicitly, the constructor disables spinning on single core machines
+        ThreadPool pool(threadCnt);
+        pool.setIdleSpinTime(std::chrono::microseconds(spin));
+        for (int gap : gaps)
+        {
+            BenchResult ret = runBench(pool, std::chrono::microseconds(gap), duration);
+            printf("%8d %8d %12.2f %12.2f %10.2f\n", spin, gap, ret.latencyAvgUs,
+                   ret.latencyP99Us, ret.cpuCores);
+        }
+    }
+    return 0;
+}
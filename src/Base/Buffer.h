@@ -7,6 +7,8 @@
 #ifndef SOFTGL_BUFFER_H
 #define SOFTGL_BUFFER_H
 
+#include <algorithm>
+
 #include "MemoryUtils.h"
 
 namespace SoftGL
@@ -166,9 +168,31 @@ public:
         T *ptr = data_.get();
         if (ptr != nullptr)
         {
-            for (int i = 0; i < dataSize_; i++)
+            MemoryUtils::fill(ptr, dataSize_, val);
+        }
+    }
+
+    // 设置矩形区域 [x0, x1) x [y0, y1) 内的元素为指定值，超出边界部分忽略
+    void setRect(std::size_t x0, std::size_t y0, std::size_t x1, std::size_t y1, const T &val)
+    {
+        T *ptr = data_.get();
+        x1 = std::min(x1, width_);
+        y1 = std::min(y1, height_);
+        if (ptr == nullptr || x0 >= x1)
+        {
+            return;
+        }
+        for (std::size_t y = y0; y < y1; y++)
+        {
+            if (getLayout() == Layout_Linear)
+            {
+                // 线性布局每行连续存储
+                MemoryUtils::fill(ptr + convertIndex(x0, y), x1 - x0, val);
+                continue;
+            }
+            for (std::size_t x = x0; x < x1; x++)
             {
-                ptr[i] = val;
+                ptr[convertIndex(x, y)] = val;
             }
         }
     }
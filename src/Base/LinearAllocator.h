@@ -0,0 +1,98 @@
+/*
+ * SoftGLRender
+ * @author 	: keith@robot9.me
+ *
+ */
+
+#pragma once
+
+#include <vector>
+
+#include "MemoryUtils.h"
+
+namespace SoftGL
+{
+
+class LinearAllocator
+{
+public:
+    explicit LinearAllocator(std::size_t chunkSize = 64 * 1024)
+        : chunkSize_(chunkSize)
+    {
+    }
+
+    ~LinearAllocator()
+    {
+        for (auto &chunk : chunks_)
+        {
+            MemoryUtils::alignedFree(chunk.data);
+        }
+    }
+
+    LinearAllocator(const LinearAllocator &) = delete;
+    LinearAllocator &operator=(const LinearAllocator &) = delete;
+
+    template <typename T>
+    inline T *allocate(std::size_t elemCnt)
+    {
+        return (T *)allocate(elemCnt * sizeof(T));
+    }
+
+    void *allocate(std::size_t size)
+    {
+        if (size == 0)
+        {
+            return nullptr;
+        }
+        size = MemoryUtils::alignedSize(size);
+
+        // find a chunk with enough space, chunks are kept after reset
+        while (chunkIdx_ < chunks_.size())
+        {
+            Chunk &chunk = chunks_[chunkIdx_];
+            if (chunk.used + size <= chunk.size)
+            {
+                void *ptr = chunk.data + chunk.used;
+                chunk.used += size;
+                return ptr;
+            }
+            chunkIdx_++;
+        }
+
+        Chunk chunk;
+        chunk.size = std::max(chunkSize_, size);
+        chunk.data = (uint8_t *)MemoryUtils::alignedMalloc(chunk.size);
+        if (!chunk.data)
+        {
+            return nullptr;
+        }
+        chunk.used = size;
+        chunks_.push_back(chunk);
+        chunkIdx_ = chunks_.size() - 1;
+        return chunk.data;
+    }
+
+    // release all allocations, memory is reused by following allocations
+    void reset()
+    {
+        for (auto &chunk : chunks_)
+        {
+            chunk.used = 0;
+        }
+        chunkIdx_ = 0;
+    }
+
+private:
+    struct Chunk
+    {
+        uint8_t *data = nullptr;
+        std::size_t size = 0;
+        std::size_t used = 0;
+    };
+
+    std::size_t chunkSize_;
+    std::size_t chunkIdx_ = 0;
+    std::vector<Chunk> chunks_;
+};
+
+} // namespace SoftGL
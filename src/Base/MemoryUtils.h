@@ -8,9 +8,14 @@
 
 #include <cmath>
 #include <memory>
+#include <type_traits>
 
 #include "Logger.h"
 
+#if defined(SOFTGL_SIMD_OPT) && defined(__AVX__)
+#include <immintrin.h>
+#endif
+
 #define SOFTGL_ALIGNMENT 32
 
 namespace SoftGL
@@ -57,6 +62,33 @@ public:
         return SOFTGL_ALIGNMENT * std::ceil((float)size / (float)SOFTGL_ALIGNMENT);
     }
 
+    // 32 bytes per store when the element size divides it
+    template <typename T>
+    static void fill(T *dst, std::size_t elemCnt, const T &val)
+    {
+        std::size_t idx = 0;
+#if defined(SOFTGL_SIMD_OPT) && defined(__AVX__)
+        if constexpr (32 % sizeof(T) == 0 && std::is_trivially_copyable_v<T>)
+        {
+            constexpr std::size_t step = 32 / sizeof(T);
+            alignas(32) T pattern[step];
+            for (auto &elem : pattern)
+            {
+                elem = val;
+            }
+            __m256i v = _mm256_load_si256((const __m256i *)pattern);
+            for (; idx + step <= elemCnt; idx += step)
+            {
+                _mm256_storeu_si256((__m256i *)(dst + idx), v);
+            }
+        }
+#endif
+        for (; idx < elemCnt; idx++)
+        {
+            dst[idx] = val;
+        }
+    }
+
     template <typename T>
     static std::shared_ptr<T> makeAlignedBuffer(std::size_t elemCnt)
     {
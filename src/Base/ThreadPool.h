@@ -6,31 +6,184 @@
 
 #pragma once
 
+#include <algorithm>
 #include <atomic>
-#include <functional>
-#include <iostream>
+#include <chrono>
+#include <cstddef>
+#include <deque>
 #include <memory>
 #include <mutex>
-#include <queue>
+#include <new>
 #include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "WorkStealingQueue.h"
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#include <immintrin.h>
+#endif
 
 namespace SoftGL
 {
 
+inline void cpuRelax()
+{
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+    _mm_pause();
+#else
+    std::this_thread::yield();
+#endif
+}
+
+// spin until pred() is true or spinTime elapsed, returns the last pred() result
+template <typename Pred>
+bool spinWait(std::chrono::microseconds spinTime, const Pred &pred)
+{
+    if (spinTime.count() <= 0)
+    {
+        return pred();
+    }
+    auto deadline = std::chrono::steady_clock::now() + spinTime;
+    while (true)
+    {
+        for (int i = 0; i < 64; i++)
+        {
+            if (pred())
+            {
+                return true;
+            }
+            cpuRelax();
+        }
+        if (std::chrono::steady_clock::now() >= deadline)
+        {
+            return pred();
+        }
+        // let other threads run when cores are oversubscribed
+        std::this_thread::yield();
+    }
+}
+
+class ThreadPool;
+class TaskGroup;
+
+// type erased task, the callable is stored in place, no allocation or virtual call per task
+struct TaskSlot
+{
+    static constexpr std::size_t kStorageSize = 48;
+
+    void (*invoke)(TaskSlot &slot, std::size_t threadId) = nullptr;
+    TaskGroup *group = nullptr;
+    alignas(std::max_align_t) unsigned char storage[kStorageSize];
+};
+
+// a set of tasks that can be waited on independently of other tasks in the pool,
+// tasks are added by one thread at a time
+class TaskGroup
+{
+public:
+    explicit TaskGroup(ThreadPool &pool)
+        : pool_(pool)
+    {
+    }
+
+    ~TaskGroup()
+    {
+        wait();
+    }
+
+    TaskGroup(const TaskGroup &) = delete;
+    TaskGroup &operator=(const TaskGroup &) = delete;
+
+    // task: void(std::size_t threadId)
+    template <typename F>
+    void run(F &&task);
+
+    // workers help running pending tasks while waiting, other threads block
+    void wait();
+
+private:
+    friend class ThreadPool;
+
+    // slots stay valid until wait returns, then they are reused
+    template <typename F>
+    TaskSlot *allocSlot(F &&task)
+    {
+        using Func = std::decay_t<F>;
+        static_assert(sizeof(Func) <= TaskSlot::kStorageSize &&
+                          alignof(Func) <= alignof(std::max_align_t),
+                      "task callable does not fit the inline task slot");
+
+        if (slotCnt_ == slots_.size())
+        {
+            slots_.emplace_back();
+        }
+        TaskSlot *slot = &slots_[slotCnt_++];
+        new (slot->storage) Func(std::forward<F>(task));
+        slot->invoke = [](TaskSlot &s, std::size_t threadId)
+        {
+            Func *func = std::launder(reinterpret_cast<Func *>(s.storage));
+            (*func)(threadId);
+            func->~Func();
+        };
+        slot->group = this;
+        return slot;
+    }
+
+    inline void onTaskDone()
+    {
+        // the waiter may return as soon as pendingCnt_ reaches zero, keep it until notify is done
+        notifyingCnt_.fetch_add(1, std::memory_order_relaxed);
+        if (pendingCnt_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            pendingCnt_.notify_all();
+        }
+        notifyingCnt_.fetch_sub(1, std::memory_order_release);
+    }
+
+    inline void waitNotifyDone() const
+    {
+        while (notifyingCnt_.load(std::memory_order_acquire) != 0)
+        {
+            std::this_thread::yield();
+        }
+    }
+
+private:
+    ThreadPool &pool_;
+    std::atomic<uint32_t> pendingCnt_{0};
+    std::atomic<uint32_t> notifyingCnt_{0};
+
+    // deque keeps slot addresses stable while growing
+    std::deque<TaskSlot> slots_;
+    std::size_t slotCnt_ = 0;
+};
+
 class ThreadPool
 {
 public:
-    explicit ThreadPool(const std::size_t threadCnt = std::thread::hardware_concurrency())
-        : threadCnt_(threadCnt)
-        , threads_(new std::thread[threadCnt])
+    // idle workers spin this long before sleeping, short gaps between tasks then cost no wake up
+    static constexpr std::chrono::microseconds kDefaultIdleSpinTime{50};
+
+    explicit ThreadPool(std::size_t threadCnt = std::thread::hardware_concurrency(),
+                        std::chrono::microseconds idleSpinTime = kDefaultIdleSpinTime)
+        : threadCnt_(std::max<std::size_t>(threadCnt, 1))
+        , defaultGroup_(*this)
     {
+        // spinning only steals time from the thread doing work on a single core
+        if (std::thread::hardware_concurrency() > 1)
+        {
+            setIdleSpinTime(idleSpinTime);
+        }
         createThreads();
     }
 
     ~ThreadPool()
     {
         waitTasksFinish();
-        running_ = false;
+        running_.store(false);
+        wakeWorkers(true);
         joinThreads();
     }
 
@@ -39,109 +192,300 @@ public:
         return threadCnt_;
     }
 
+    // 0 makes idle workers and waiters sleep immediately
+    inline void setIdleSpinTime(std::chrono::microseconds spinTime)
+    {
+        idleSpinUs_.store(std::max<int64_t>(spinTime.count(), 0), std::memory_order_relaxed);
+    }
+
+    inline std::chrono::microseconds getIdleSpinTime() const
+    {
+        return std::chrono::microseconds(idleSpinUs_.load(std::memory_order_relaxed));
+    }
+
+    // task: void(std::size_t threadId), threadId is in [0, getThreadCnt()),
+    // called by one thread at a time
     template <typename F>
-    void pushTask(const F &task)
+    void pushTask(F &&task)
     {
-        tasksCnt_++;
-        {
-            const std::lock_guard<std::mutex> lock(mutex_);
-            tasks_.push(std::function<void(std::size_t)>(task));
-        }
+        defaultGroup_.run(std::forward<F>(task));
     }
 
-    template <typename F, typename... A>
-    void pushTask(const F &task, const A &...args)
+    // wait for all tasks pushed by pushTask
+    void waitTasksFinish()
     {
-        pushTask([task, args...] { task(args...); });
+        defaultGroup_.wait();
     }
 
-    void waitTasksFinish() const
+    // split [begin, end) into ranges of grain size and run them in parallel, blocks until done
+    // func: void(std::size_t rangeBegin, std::size_t rangeEnd, std::size_t threadId)
+    template <typename F>
+    void parallelFor(std::size_t begin, std::size_t end, std::size_t grain, const F &func)
     {
-        while (true)
+        if (begin >= end)
         {
-            if (!paused)
-            {
-                if (tasksCnt_ == 0)
-                    break;
-            }
-            else
+            return;
+        }
+        grain = std::max<std::size_t>(grain, 1);
+        std::size_t rangeCnt = (end - begin + grain - 1) / grain;
+
+        // one task per worker pulling ranges from a shared counter, instead of one task per range
+        std::atomic<std::size_t> next{begin};
+        auto runner = [&](std::size_t threadId)
+        {
+            while (true)
             {
-                if (tasksRunningCnt() == 0)
+                std::size_t rangeBegin = next.fetch_add(grain, std::memory_order_relaxed);
+                if (rangeBegin >= end)
+                {
                     break;
+                }
+                func(rangeBegin, std::min(rangeBegin + grain, end), threadId);
             }
-            std::this_thread::yield();
+        };
+
+        TaskGroup group(*this);
+        std::size_t taskCnt = std::min(rangeCnt, threadCnt_);
+        for (std::size_t i = 0; i < taskCnt; i++)
+        {
+            group.run(runner);
         }
+        group.wait();
     }
 
-    std::atomic<bool> paused{false};
-
 private:
+    friend class TaskGroup;
+
+    struct Worker
+    {
+        WorkStealingQueue<TaskSlot *> queue;
+        std::thread thread;
+        uint32_t randState = 0;
+    };
+
+    template <typename F>
+    void submit(TaskGroup &group, F &&func)
+    {
+        TaskSlot *task = group.allocSlot(std::forward<F>(func));
+        group.pendingCnt_.fetch_add(1, std::memory_order_relaxed);
+
+        if (currentPool_ == this)
+        {
+            // spawned from a worker, keep it local, idle workers will steal it
+            workers_[currentWorkerIdx_]->queue.push(task);
+        }
+        else
+        {
+            const std::lock_guard<std::mutex> lock(injectMutex_);
+            injectTasks_.push_back(task);
+            injectCnt_.fetch_add(1, std::memory_order_release);
+        }
+        wakeWorkers(false);
+    }
+
     void createThreads()
     {
+        workers_.resize(threadCnt_);
         for (std::size_t i = 0; i < threadCnt_; i++)
         {
-            threads_[i] = std::thread(&ThreadPool::taskWorker, this, i);
+            workers_[i] = std::make_unique<Worker>();
+            workers_[i]->randState = (uint32_t)i * 0x9E3779B9u + 1u;
+        }
+        for (std::size_t i = 0; i < threadCnt_; i++)
+        {
+            workers_[i]->thread = std::thread(&ThreadPool::taskWorker, this, i);
         }
     }
 
     void joinThreads()
     {
-        for (std::size_t i = 0; i < threadCnt_; i++)
+        for (auto &worker : workers_)
         {
-            threads_[i].join();
+            worker->thread.join();
         }
     }
 
-    std::size_t tasksQueuedCnt() const
+    void wakeWorkers(bool all)
     {
-        const std::lock_guard<std::mutex> lock(mutex_);
-        return tasks_.size();
+        wakeEpoch_.fetch_add(1, std::memory_order_seq_cst);
+        if (sleepingCnt_.load(std::memory_order_seq_cst) > 0)
+        {
+            if (all)
+            {
+                wakeEpoch_.notify_all();
+            }
+            else
+            {
+                wakeEpoch_.notify_one();
+            }
+        }
     }
 
-    std::size_t tasksRunningCnt() const
+    bool popInjectTask(TaskSlot *&task)
     {
-        return tasksCnt_ - tasksQueuedCnt();
+        if (injectCnt_.load(std::memory_order_acquire) == 0)
+        {
+            return false;
+        }
+        const std::lock_guard<std::mutex> lock(injectMutex_);
+        if (injectTasks_.empty())
+        {
+            return false;
+        }
+        task = injectTasks_.front();
+        injectTasks_.pop_front();
+        injectCnt_.fetch_sub(1, std::memory_order_relaxed);
+        return true;
     }
 
-    bool popTask(std::function<void(std::size_t)> &task)
+    bool stealTask(std::size_t workerIdx, TaskSlot *&task)
     {
-        const std::lock_guard<std::mutex> lock(mutex_);
-        if (tasks_.empty())
+        if (threadCnt_ <= 1)
+        {
             return false;
-        else
+        }
+
+        // xorshift, start from a random victim to spread contention
+        uint32_t &x = workers_[workerIdx]->randState;
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+
+        std::size_t start = x % threadCnt_;
+        for (std::size_t i = 0; i < threadCnt_; i++)
         {
-            task = std::move(tasks_.front());
-            tasks_.pop();
-            return true;
+            std::size_t victim = (start + i) % threadCnt_;
+            if (victim != workerIdx && workers_[victim]->queue.steal(task))
+            {
+                return true;
+            }
         }
+        return false;
+    }
+
+    bool findTask(std::size_t workerIdx, TaskSlot *&task)
+    {
+        return workers_[workerIdx]->queue.pop(task) || popInjectTask(task)
+               || stealTask(workerIdx, task);
     }
 
-    void taskWorker(std::size_t threadId)
+    static void runTask(TaskSlot *task, std::size_t threadId)
     {
-        while (running_)
+        task->invoke(*task, threadId);
+        task->group->onTaskDone();
+    }
+
+    void taskWorker(std::size_t workerIdx)
+    {
+        currentPool_ = this;
+        currentWorkerIdx_ = workerIdx;
+
+        TaskSlot *task = nullptr;
+        while (true)
         {
-            std::function<void(std::size_t)> task;
-            if (!paused && popTask(task))
+            if (spinWait(getIdleSpinTime(), [&]() { return findTask(workerIdx, task); }))
             {
-                task(threadId);
-                tasksCnt_--;
+                runTask(task, workerIdx);
+                continue;
             }
-            else
+
+            // announce sleeping before the final check, so a concurrent submit either is seen here
+            // or observes the sleeper and notifies
+            sleepingCnt_.fetch_add(1, std::memory_order_seq_cst);
+            uint32_t epoch = wakeEpoch_.load(std::memory_order_seq_cst);
+            if (findTask(workerIdx, task))
             {
-                std::this_thread::yield();
+                sleepingCnt_.fetch_sub(1, std::memory_order_relaxed);
+                runTask(task, workerIdx);
+                continue;
+            }
+            if (!running_.load())
+            {
+                sleepingCnt_.fetch_sub(1, std::memory_order_relaxed);
+                break;
+            }
+            wakeEpoch_.wait(epoch, std::memory_order_seq_cst);
+            sleepingCnt_.fetch_sub(1, std::memory_order_relaxed);
+        }
+
+        currentPool_ = nullptr;
+    }
+
+    // called by TaskGroup::wait on a worker thread of this pool
+    void helpUntilDone(TaskGroup &group)
+    {
+        TaskSlot *task = nullptr;
+        auto done = [&]() { return group.pendingCnt_.load(std::memory_order_acquire) == 0; };
+        while (!done())
+        {
+            if (findTask(currentWorkerIdx_, task))
+            {
+                runTask(task, currentWorkerIdx_);
+                continue;
+            }
+
+            // the rest of the group runs on other workers, spin a while for new work then block
+            bool found = false;
+            spinWait(getIdleSpinTime(), [&]()
+                     { return (found = findTask(currentWorkerIdx_, task)) || done(); });
+            if (found)
+            {
+                runTask(task, currentWorkerIdx_);
+                continue;
+            }
+            uint32_t cnt;
+            while ((cnt = group.pendingCnt_.load(std::memory_order_acquire)) != 0)
+            {
+                group.pendingCnt_.wait(cnt, std::memory_order_acquire);
             }
         }
     }
 
 private:
-    mutable std::mutex mutex_ = {};
+    std::size_t threadCnt_;
+    std::vector<std::unique_ptr<Worker>> workers_;
     std::atomic<bool> running_{true};
+    std::atomic<int64_t> idleSpinUs_{0};
+
+    // tasks submitted from non-worker threads
+    std::mutex injectMutex_;
+    std::deque<TaskSlot *> injectTasks_;
+    std::atomic<std::size_t> injectCnt_{0};
 
-    std::unique_ptr<std::thread[]> threads_;
-    std::atomic<std::size_t> threadCnt_{0};
+    // idle workers block on epoch changes
+    std::atomic<uint32_t> wakeEpoch_{0};
+    std::atomic<uint32_t> sleepingCnt_{0};
 
-    std::queue<std::function<void(std::size_t)>> tasks_ = {};
-    std::atomic<std::size_t> tasksCnt_{0};
+    TaskGroup defaultGroup_;
+
+    static inline thread_local ThreadPool *currentPool_ = nullptr;
+    static inline thread_local std::size_t currentWorkerIdx_ = 0;
 };
 
+template <typename F>
+void TaskGroup::run(F &&task)
+{
+    pool_.submit(*this, std::forward<F>(task));
+}
+
+inline void TaskGroup::wait()
+{
+    if (ThreadPool::currentPool_ == &pool_)
+    {
+        pool_.helpUntilDone(*this);
+    }
+    else
+    {
+        spinWait(pool_.getIdleSpinTime(),
+                 [&]() { return pendingCnt_.load(std::memory_order_acquire) == 0; });
+        uint32_t cnt;
+        while ((cnt = pendingCnt_.load(std::memory_order_acquire)) != 0)
+        {
+            pendingCnt_.wait(cnt, std::memory_order_acquire);
+        }
+    }
+    waitNotifyDone();
+    slotCnt_ = 0;
+}
+
 } // namespace SoftGL
@@ -0,0 +1,145 @@
+/*
+ * SoftGLRender
+ * @author 	: keith@robot9.me
+ *
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace SoftGL
+{
+
+// Chase-Lev work stealing deque
+// Ref: https://fzn.fr/readings/ppopp13.pdf
+// owner thread pushes/pops at bottom, other threads steal from top
+template <typename T>
+class WorkStealingQueue
+{
+public:
+    explicit WorkStealingQueue(int64_t capacity = 1024)
+    {
+        auto *array = new Array(capacity);
+        garbage_.emplace_back(array);
+        array_.store(array, std::memory_order_relaxed);
+    }
+
+    WorkStealingQueue(const WorkStealingQueue &) = delete;
+    WorkStealingQueue &operator=(const WorkStealingQueue &) = delete;
+
+    inline bool empty() const
+    {
+        int64_t b = bottom_.load(std::memory_order_relaxed);
+        int64_t t = top_.load(std::memory_order_relaxed);
+        return b <= t;
+    }
+
+    // owner only
+    void push(T item)
+    {
+        int64_t b = bottom_.load(std::memory_order_relaxed);
+        int64_t t = top_.load(std::memory_order_acquire);
+        Array *array = array_.load(std::memory_order_relaxed);
+        if (b - t > array->capacity - 1)
+        {
+            // old arrays may still be read by thieves, keep them until destruction
+            array = array->grow(b, t);
+            garbage_.emplace_back(array);
+            array_.store(array, std::memory_order_release);
+        }
+        array->put(b, item);
+        bottom_.store(b + 1, std::memory_order_release);
+    }
+
+    // owner only
+    bool pop(T &item)
+    {
+        int64_t b = bottom_.load(std::memory_order_relaxed) - 1;
+        Array *array = array_.load(std::memory_order_relaxed);
+        bottom_.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = top_.load(std::memory_order_relaxed);
+
+        if (t > b)
+        {
+            // empty
+            bottom_.store(b + 1, std::memory_order_relaxed);
+            return false;
+        }
+
+        item = array->get(b);
+        if (t == b)
+        {
+            // last item, race against thieves
+            bool won = top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                                    std::memory_order_relaxed);
+            bottom_.store(b + 1, std::memory_order_relaxed);
+            return won;
+        }
+        return true;
+    }
+
+    // any thread
+    bool steal(T &item)
+    {
+        int64_t t = top_.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t b = bottom_.load(std::memory_order_acquire);
+
+        if (t >= b)
+        {
+            return false;
+        }
+
+        Array *array = array_.load(std::memory_order_acquire);
+        item = array->get(t);
+        return top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                            std::memory_order_relaxed);
+    }
+
+private:
+    struct Array
+    {
+        explicit Array(int64_t cap)
+            : capacity(cap)
+            , mask(cap - 1)
+            , items(new std::atomic<T>[cap])
+        {
+        }
+
+        inline void put(int64_t i, T item)
+        {
+            items[i & mask].store(item, std::memory_order_relaxed);
+        }
+
+        inline T get(int64_t i) const
+        {
+            return items[i & mask].load(std::memory_order_relaxed);
+        }
+
+        Array *grow(int64_t b, int64_t t) const
+        {
+            auto *array = new Array(capacity * 2);
+            for (int64_t i = t; i < b; i++)
+            {
+                array->put(i, get(i));
+            }
+            return array;
+        }
+
+        int64_t capacity;
+        int64_t mask;
+        std::unique_ptr<std::atomic<T>[]> items;
+    };
+
+    alignas(64) std::atomic<int64_t> top_{0};
+    alignas(64) std::atomic<int64_t> bottom_{0};
+    std::atomic<Array *> array_{nullptr};
+    std::vector<std::unique_ptr<Array>> garbage_;
+};
+
+} // namespace SoftGL
@@ -0,0 +1,42 @@
+/*
+ * SoftGLRender
+ * @author 	: keith@robot9.me
+ *
+ */
+
+#pragma once
+
+#include "Render/PipelineStates.h"
+#include "RendererInternal.h"
+
+namespace SoftGL
+{
+
+class PipelineStatesSoft : public PipelineStates
+{
+public:
+    explicit PipelineStatesSoft(const RenderStates &states)
+        : PipelineStates(states)
+    {
+    }
+
+    // attachments are only known when the draw executes, kernels of all combinations are prepared
+    inline PixelQuadKernel getPixelQuadKernel(bool hasColor, bool hasDepth, bool multiSample) const
+    {
+        return pixelQuadKernels[hasColor][hasDepth][multiSample];
+    }
+
+    inline DepthStepKernel getDepthStepKernel(bool multiSample) const
+    {
+        return depthStepKernels[multiSample];
+    }
+
+public:
+    // indexed by [hasColor][hasDepth][multiSample]
+    PixelQuadKernel pixelQuadKernels[2][2][2] = {};
+
+    // indexed by [multiSample]
+    DepthStepKernel depthStepKernels[2] = {};
+};
+
+} // namespace SoftGL
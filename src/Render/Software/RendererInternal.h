@@ -6,7 +6,9 @@
 
 #pragma once
 
+#include "Base/Geometry.h"
 #include "Base/MemoryUtils.h"
+#include "Render/RenderStates.h"
 #include "Render/Software/ShaderProgramSoft.h"
 
 namespace SoftGL
@@ -35,14 +37,34 @@ struct VertexHolder
     std::size_t index = 0;
 
     void *vertex = nullptr;
-    float *varyings = nullptr;
+    void *varyings = nullptr; // floats, or halves for draws with half varyings
 
     int clipMask = 0;
     glm::aligned_vec4 clipPos = glm::vec4(0.f); // clip space position
     glm::aligned_vec4 fragPos = glm::vec4(0.f); // screen space position
+};
+
+// clip space positions of shaded vertexes in SoA layout, post-processed 8 at a time
+#define VERTEX_BLOCK_SIZE 64
 
-    std::shared_ptr<uint8_t> vertexHolder = nullptr;
-    std::shared_ptr<float> varyingsHolder = nullptr;
+struct VertexBlock
+{
+    alignas(32) float clipX[VERTEX_BLOCK_SIZE];
+    alignas(32) float clipY[VERTEX_BLOCK_SIZE];
+    alignas(32) float clipZ[VERTEX_BLOCK_SIZE];
+    alignas(32) float clipW[VERTEX_BLOCK_SIZE];
+    std::size_t index[VERTEX_BLOCK_SIZE];
+    int count = 0;
+
+    void add(std::size_t idx, const glm::vec4 &clipPos)
+    {
+        clipX[count] = clipPos.x;
+        clipY[count] = clipPos.y;
+        clipZ[count] = clipPos.z;
+        clipW[count] = clipPos.w;
+        index[count] = idx;
+        count++;
+    }
 };
 
 struct PrimitiveHolder
@@ -52,6 +74,102 @@ struct PrimitiveHolder
     std::size_t indices[3] = {0, 0, 0};
 };
 
+// fixed-point subpixel precision of triangle rasterization, exact for 4x MSAA sample locations
+#define RASTER_SUBPIXEL_BITS 4
+#define RASTER_LANE_MAX 24
+
+struct TriangleSetup
+{
+    // triangle vertex screen space position
+    glm::aligned_vec4 vertPos[3];
+
+    // fixed-point edge functions E(x, y) = A * x + B * y + C, positive inside,
+    // edge i is opposite to vertex i, so E / (E0 + E1 + E2) is the barycentric weight of vertex i
+    int64_t edgeA[3] = {0, 0, 0};
+    int64_t edgeB[3] = {0, 0, 0};
+    int64_t edgeC[3] = {0, 0, 0};
+    int32_t edgeBias[3] = {0, 0, 0}; // top-left rule, 1 if samples exactly on the edge are inside
+
+    // barycentric gradients, from the unsnapped positions to keep interpolation precision
+    float baryDx[3] = {0.f, 0.f, 0.f};
+    float baryDy[3] = {0.f, 0.f, 0.f};
+
+    // vertex z and w values, weighted by the barycentric of each sample,
+    // copied so rasterization never reads the vertex holders
+    glm::aligned_vec4 vertZ = glm::aligned_vec4(0.f);
+    glm::aligned_vec4 vertW = glm::aligned_vec4(0.f, 0.f, 0.f, 1.f);
+
+    // triangle vertex shader varyings
+    const void *vertVaryings[3] = {nullptr, nullptr, nullptr};
+
+    // triangle Facing
+    bool frontFacing = true;
+
+    // screen space bounds, clamped to viewport
+    BoundingBox bounds;
+
+    // bounds fit in a single raster step per quad row, rasterized without block setup
+    bool micro = false;
+};
+
+// triangle setups of a draw batch, built once by the render thread and read by index from the
+// tile tasks, per tile rejection only reads the packed draw index and depth range arrays
+struct TriangleSetupArray
+{
+    std::vector<TriangleSetup> setups;
+
+    // index of the draw in the render pass batch
+    std::vector<uint32_t> drawIdx;
+
+    // depth range, slightly expanded to cover interpolation rounding
+    std::vector<float> minZ;
+    std::vector<float> maxZ;
+
+    std::size_t size() const
+    {
+        return setups.size();
+    }
+
+    void clear()
+    {
+        setups.clear();
+        drawIdx.clear();
+        minZ.clear();
+        maxZ.clear();
+    }
+};
+
+// point or line setup, a point has both ends at the same position
+struct LineSetup
+{
+    // end points screen space position
+    glm::aligned_vec4 vertPos[2];
+
+    // end points vertex shader varyings
+    const void *vertVaryings[2] = {nullptr, nullptr};
+
+    // point size or line width in pixels
+    float width = 1.f;
+    bool isPoint = false;
+
+    // facing of the polygon drawn in point or line mode
+    bool frontFacing = true;
+
+    // screen space bounds, clamped to viewport
+    BoundingBox bounds;
+
+    // index of the draw in the render pass batch
+    uint32_t drawIdx = 0;
+};
+
+// hierarchical z, depth bounds of one screen tile
+struct HiZTile
+{
+    float minZ = 0.f;
+    float maxZ = 1.f;
+    bool dirty = true; // bounds are conservative, recompute before use
+};
+
 class SampleContext
 {
 public:
@@ -80,34 +198,28 @@ public:
         inside = false;
         sampleCount = sample_cnt;
         coverage = 0;
-        if (sampleCount > 1)
+        samples.resize(sampleCount > 1 ? sampleCount + 1 : 1); // store center sample at end
+        MoveTo(x, y);
+    }
+
+    // place the samples of an initialized pixel at (x, y), sample count unchanged
+    void MoveTo(float x, float y)
+    {
+        if (sampleCount == 4)
         {
-            samples.resize(sampleCount + 1); // store center sample at end
-            if (sampleCount == 4)
-            {
-                for (int i = 0; i < sampleCount; i++)
-                {
-                    samples[i].fboCoord = glm::ivec2(x, y);
-                    samples[i].position =
-                        glm::vec4(GetSampleLocation4X()[i] + glm::vec2(x, y), 0.f, 0.f);
-                }
-                // pixel center
-                samples[4].fboCoord = glm::ivec2(x, y);
-                samples[4].position = glm::vec4(x + 0.5f, y + 0.5f, 0.f, 0.f);
-                sampleShading = &samples[4];
-            }
-            else
+            for (int i = 0; i < sampleCount; i++)
             {
-                // not support
+                samples[i].fboCoord = glm::ivec2(x, y);
+                samples[i].position =
+                    glm::vec4(GetSampleLocation4X()[i] + glm::vec2(x, y), 0.f, 0.f);
             }
         }
-        else
-        {
-            samples.resize(1);
-            samples[0].fboCoord = glm::ivec2(x, y);
-            samples[0].position = glm::vec4(x + 0.5f, y + 0.5f, 0.f, 0.f);
-            sampleShading = &samples[0];
-        }
+
+        // pixel center
+        SampleContext &center = samples.back();
+        center.fboCoord = glm::ivec2(x, y);
+        center.position = glm::vec4(x + 0.5f, y + 0.5f, 0.f, 0.f);
+        sampleShading = &center;
     }
 
     bool InitCoverage()
@@ -158,6 +270,102 @@ public:
     int coverage = 0;
 };
 
+class RasterLaneLayout
+{
+public:
+    void Init(int sample_cnt)
+    {
+        laneCnt = 0;
+        if (sample_cnt > 1)
+        {
+            // one quad per step: 4 samples of each pixel, then 4 pixel centers
+            quadCnt = 1;
+            for (int p = 0; p < 4; p++)
+            {
+                for (int s = 0; s < sample_cnt; s++)
+                {
+                    glm::vec2 location = PixelContext::GetSampleLocation4X()[s];
+                    AddLane(0, p, s, location.x, location.y);
+                }
+            }
+            for (int p = 0; p < 4; p++)
+            {
+                AddLane(0, p, sample_cnt, 0.5f, 0.5f);
+            }
+        }
+        else
+        {
+            // two quads side by side per step, pixel centers only
+            quadCnt = 2;
+            for (int q = 0; q < 2; q++)
+            {
+                for (int p = 0; p < 4; p++)
+                {
+                    AddLane(q, p, 0, 0.5f, 0.5f);
+                }
+            }
+        }
+
+        for (int q = 0; q < quadCnt; q++)
+        {
+            coverageMask[q] = 0;
+            for (int p = 0; p < 4; p++)
+            {
+                for (int s = 0; s < std::max(sample_cnt, 1); s++)
+                {
+                    coverageMask[q] |= 1u << lane[q][p][s];
+                }
+            }
+        }
+
+        // pad to full 8 lanes
+        while (laneCnt % 8 != 0)
+        {
+            dx[laneCnt] = 0;
+            dy[laneCnt] = 0;
+            laneCnt++;
+        }
+    }
+
+private:
+    void AddLane(int q, int p, int s, float sx, float sy)
+    {
+        // pixel offset inside quad: p0 (0, 0), p1 (1, 0), p2 (0, 1), p3 (1, 1)
+        float x = (float)(q * 2 + (p & 1)) + sx;
+        float y = (float)(p >> 1) + sy;
+        dx[laneCnt] = (int32_t)(x * (1 << RASTER_SUBPIXEL_BITS));
+        dy[laneCnt] = (int32_t)(y * (1 << RASTER_SUBPIXEL_BITS));
+        lane[q][p][s] = laneCnt++;
+    }
+
+public:
+    // lanes of pixels in columns [minCol, maxCol] and rows [minRow, maxRow] of the step
+    uint32_t PixelRectMask(int minCol, int maxCol, int minRow, int maxRow) const
+    {
+        uint32_t mask = 0;
+        for (int l = 0; l < laneCnt; l++)
+        {
+            int col = dx[l] >> RASTER_SUBPIXEL_BITS;
+            int row = dy[l] >> RASTER_SUBPIXEL_BITS;
+            bool inside = col >= minCol && col <= maxCol && row >= minRow && row <= maxRow;
+            mask |= (uint32_t)inside << l;
+        }
+        return mask;
+    }
+
+public:
+    int quadCnt = 0;
+    int laneCnt = 0;
+
+    // subpixel sample offsets relative to the step origin
+    alignas(32) int32_t dx[RASTER_LANE_MAX];
+    alignas(32) int32_t dy[RASTER_LANE_MAX];
+
+    // quad, pixel, sample (center at the end for MSAA) -> lane
+    int lane[2][4][5];
+    uint32_t coverageMask[2] = {0, 0};
+};
+
 class PixelQuadContext
 {
 public:
@@ -166,11 +374,26 @@ public:
         if (varyingsAlignedCnt_ != size)
         {
             varyingsAlignedCnt_ = size;
-            varyingsPool_ = MemoryUtils::makeAlignedBuffer<float>(4 * varyingsAlignedCnt_);
+            varyingsPool_ = MemoryUtils::makeAlignedBuffer<float>(8 * varyingsAlignedCnt_);
             for (int i = 0; i < 4; i++)
             {
                 pixels[i].varyingsFrag = varyingsPool_.get() + i * varyingsAlignedCnt_;
             }
+            varyingsQuad = varyingsPool_.get() + 4 * varyingsAlignedCnt_;
+        }
+    }
+
+    // SHADER_WIDE_LANES floats per attribute and per varying of the wide vertex shader
+    void SetVertexWideSize(std::size_t attributesCnt, std::size_t varyingsCnt)
+    {
+        if (attributesWideCnt_ != attributesCnt || varyingsWideCnt_ != varyingsCnt)
+        {
+            attributesWideCnt_ = attributesCnt;
+            varyingsWideCnt_ = varyingsCnt;
+            vertexWidePool_ = MemoryUtils::makeAlignedBuffer<float>(
+                (attributesCnt + varyingsCnt) * SHADER_WIDE_LANES);
+            attributesWide = vertexWidePool_.get();
+            varyingsWide = attributesWide + attributesCnt * SHADER_WIDE_LANES;
         }
     }
 
@@ -182,6 +405,15 @@ public:
         pixels[3].Init(x + 1, y + 1, sample_cnt);
     }
 
+    // place an initialized quad at (x, y)
+    void MoveTo(float x, float y)
+    {
+        pixels[0].MoveTo(x, y);
+        pixels[1].MoveTo(x + 1, y);
+        pixels[2].MoveTo(x, y + 1);
+        pixels[3].MoveTo(x + 1, y + 1);
+    }
+
     bool CheckInside()
     {
         return pixels[0].inside || pixels[1].inside || pixels[2].inside || pixels[3].inside;
@@ -195,26 +427,116 @@ public:
      */
     PixelContext pixels[4];
 
-    // triangle vertex screen space position
-    glm::aligned_vec4 vertPos[3];
-    glm::aligned_vec4 vertPosFlat[4];
-
-    // triangle barycentric correct
-    const float *vertZ[3] = {nullptr, nullptr, nullptr};
-    glm::aligned_vec4 vertW = glm::aligned_vec4(0.f, 0.f, 0.f, 1.f);
-
-    // triangle vertex shader varyings
-    const float *vertVaryings[3] = {nullptr, nullptr, nullptr};
-
-    // triangle Facing
-    bool frontFacing = true;
-
     // shader program
     std::shared_ptr<ShaderProgramSoft> shaderProgram = nullptr;
 
+    // varyings of the quad pixels in lanes, for quad fragment shaders
+    float *varyingsQuad = nullptr;
+
+    // wide vertex shader lanes
+    float *attributesWide = nullptr;
+    float *varyingsWide = nullptr;
+
 private:
     std::size_t varyingsAlignedCnt_ = 0;
     std::shared_ptr<float> varyingsPool_ = nullptr;
+
+    std::size_t attributesWideCnt_ = 0;
+    std::size_t varyingsWideCnt_ = 0;
+    std::shared_ptr<float> vertexWidePool_ = nullptr;
+};
+
+enum RasterDepthMode : uint8_t
+{
+    RasterDepth_NONE, // depth test disabled or no depth attachment
+    RasterDepth_LESS,
+    RasterDepth_LEQUAL,
+    RasterDepth_GREATER,
+    RasterDepth_GEQUAL,
+    RasterDepth_GENERIC, // other depth functions, compared at runtime
+    RasterDepth_CNT,
+};
+
+enum RasterColorMode : uint8_t
+{
+    RasterColor_NONE,          // no color attachment
+    RasterColor_WRITE,         // blending disabled
+    RasterColor_BLEND_ALPHA,   // src alpha, one minus src alpha, add
+    RasterColor_BLEND_GENERIC, // other blend parameters, evaluated at runtime
+    RasterColor_CNT,
+};
+
+// states a pixel quad kernel is compiled for
+struct RasterKernelSpec
+{
+    RasterDepthMode depthMode = RasterDepth_NONE;
+    bool depthWrite = false;
+    RasterColorMode colorMode = RasterColor_NONE;
+    bool multiSample = false;
+
+    static constexpr std::size_t kKeyCnt = RasterDepth_CNT * 2 * RasterColor_CNT * 2;
+    static constexpr std::size_t kDepthKeyCnt = RasterDepth_CNT * 2 * 2;
+
+    constexpr std::size_t key() const
+    {
+        return ((depthMode * 2 + depthWrite) * RasterColor_CNT + colorMode) * 2 + multiSample;
+    }
+
+    // key among specs without color
+    constexpr std::size_t depthKey() const
+    {
+        return (depthMode * 2 + depthWrite) * 2 + multiSample;
+    }
+
+    static constexpr RasterKernelSpec fromKey(std::size_t key)
+    {
+        RasterKernelSpec spec;
+        spec.multiSample = key % 2;
+        spec.colorMode = (RasterColorMode)(key / 2 % RasterColor_CNT);
+        spec.depthWrite = key / (2 * RasterColor_CNT) % 2;
+        spec.depthMode = (RasterDepthMode)(key / (4 * RasterColor_CNT));
+
+        // no depth writes without depth test, shares the kernel
+        spec.depthWrite &= spec.depthMode != RasterDepth_NONE;
+        return spec;
+    }
+
+    static constexpr RasterKernelSpec fromDepthKey(std::size_t key)
+    {
+        return fromKey((key / 2 * RasterColor_CNT + RasterColor_NONE) * 2 + key % 2);
+    }
+};
+
+class RendererSoft;
+struct DrawContext;
+
+// rasterize one pixel quad, from coverage to frame buffer writes
+using PixelQuadKernel = void (*)(RendererSoft &renderer, PixelQuadContext &quad,
+                                 TriangleSetup &triangle, DrawContext &draw);
+
+// depth only rasterization of the covered sample lanes of one step, without varyings or shading
+using DepthStepKernel = void (*)(RendererSoft &renderer, TriangleSetup &triangle,
+                                 DrawContext &draw, int x, int y, int x1, uint32_t mask,
+                                 const float bc[3][RASTER_LANE_MAX]);
+
+// per draw states used by rasterization, kept alive until the draw batch is rasterized
+struct DrawContext
+{
+    const RenderStates *renderState = nullptr;
+    Viewport viewport{};
+    std::size_t varyingsCnt = 0;
+    bool varyingsHalf = false;
+    bool fragmentQuad = false; // quad fragment shader, color attachment written
+    bool hiZEnabled = false;
+    PixelQuadKernel pixelQuadKernel = nullptr;
+    DepthStepKernel depthStepKernel = nullptr; // set for depth only draws
+
+    // vertex shader output referenced by primitive setups
+    std::vector<VertexHolder> vertexes;
+    std::shared_ptr<float> varyings = nullptr;
+
+    // per thread shader program
+    std::vector<PixelQuadContext> threadQuadCtx;
 };
 
 } // namespace SoftGL
@@ -6,11 +6,15 @@
 
 #include "RendererSoft.h"
 
+#include <bit>
+#include <glm/gtc/packing.hpp>
+
 #include "Base/HashUtils.h"
 #include "Base/SIMD.h"
 #include "BlendSoft.h"
 #include "DepthSoft.h"
 #include "FramebufferSoft.h"
+#include "PipelineStatesSoft.h"
 #include "ShaderProgramSoft.h"
 #include "TextureSoft.h"
 #include "UniformSoft.h"
@@ -21,6 +25,40 @@ namespace SoftGL
 
 #define RASTER_MULTI_THREAD
 
+// guard band size relative to viewport, triangles inside it skip x/y plane clipping
+#define GUARD_BAND_SCALE 8.f
+
+const glm::vec4 GuardBandClipPlane[4] = {{-1, 0, 0, GUARD_BAND_SCALE},
+                                         {1, 0, 0, GUARD_BAND_SCALE},
+                                         {0, -1, 0, GUARD_BAND_SCALE},
+                                         {0, 1, 0, GUARD_BAND_SCALE}};
+
+static inline float halfToFloat(uint16_t v)
+{
+#if defined(SOFTGL_SIMD_OPT) && defined(__F16C__)
+    return _cvtsh_ss(v);
+#else
+    return glm::unpackHalf1x16(v);
+#endif
+}
+
+// pack vertex shader output to half varyings, 8 at a time into the padded vertex storage
+static inline void packHalfVaryings(uint16_t *out, const float *in, std::size_t cnt)
+{
+    std::size_t idx = 0;
+#if defined(SOFTGL_SIMD_OPT) && defined(__F16C__)
+    for (; idx < cnt; idx += 8)
+    {
+        __m128i packed = _mm256_cvtps_ph(_mm256_loadu_ps(in + idx), _MM_FROUND_TO_NEAREST_INT);
+        _mm_storeu_si128((__m128i *)(out + idx), packed);
+    }
+#endif
+    for (; idx < cnt; idx++)
+    {
+        out[idx] = glm::packHalf1x16(in[idx]);
+    }
+}
+
 // framebuffer
 std::shared_ptr<FrameBuffer> RendererSoft::createFrameBuffer(bool offscreen)
 {
@@ -51,10 +89,67 @@ std::shared_ptr<ShaderProgram> RendererSoft::createShaderProgram()
     return std::make_shared<ShaderProgramSoft>();
 }
 
+static RasterKernelSpec rasterKernelSpec(const RenderStates &states, bool hasColor, bool hasDepth,
+                                         bool multiSample)
+{
+    RasterKernelSpec spec;
+    spec.multiSample = multiSample;
+
+    if (states.depthTest && hasDepth)
+    {
+        switch (states.depthFunc)
+        {
+        case DepthFunc_LESS: spec.depthMode = RasterDepth_LESS; break;
+        case DepthFunc_LEQUAL: spec.depthMode = RasterDepth_LEQUAL; break;
+        case DepthFunc_GREATER: spec.depthMode = RasterDepth_GREATER; break;
+        case DepthFunc_GEQUAL: spec.depthMode = RasterDepth_GEQUAL; break;
+        default: spec.depthMode = RasterDepth_GENERIC; break;
+        }
+        spec.depthWrite = states.depthMask;
+    }
+
+    if (hasColor)
+    {
+        const BlendParameters &params = states.blendParams;
+        bool alphaBlend = params.blendFuncRgb == BlendFunc_ADD &&
+                          params.blendFuncAlpha == BlendFunc_ADD &&
+                          params.blendSrcRgb == BlendFactor_SRC_ALPHA &&
+                          params.blendSrcAlpha == BlendFactor_SRC_ALPHA &&
+                          params.blendDstRgb == BlendFactor_ONE_MINUS_SRC_ALPHA &&
+                          params.blendDstAlpha == BlendFactor_ONE_MINUS_SRC_ALPHA;
+        if (!states.blend)
+        {
+            spec.colorMode = RasterColor_WRITE;
+        }
+        else
+        {
+            spec.colorMode = alphaBlend ? RasterColor_BLEND_ALPHA : RasterColor_BLEND_GENERIC;
+        }
+    }
+    return spec;
+}
+
 // pipeline states
 std::shared_ptr<PipelineStates> RendererSoft::createPipelineStates(const RenderStates &renderStates)
 {
-    return std::make_shared<PipelineStates>(renderStates);
+    auto states = std::make_shared<PipelineStatesSoft>(renderStates);
+    for (int color = 0; color < 2; color++)
+    {
+        for (int depth = 0; depth < 2; depth++)
+        {
+            for (int ms = 0; ms < 2; ms++)
+            {
+                states->pixelQuadKernels[color][depth][ms] =
+                    getPixelQuadKernel(rasterKernelSpec(renderStates, color, depth, ms));
+            }
+        }
+    }
+    for (int ms = 0; ms < 2; ms++)
+    {
+        states->depthStepKernels[ms] =
+            getDepthStepKernel(rasterKernelSpec(renderStates, false, true, ms));
+    }
+    return states;
 }
 
 // uniform
@@ -73,75 +168,62 @@ std::shared_ptr<UniformSampler> RendererSoft::createUniformSampler(const std::st
 void RendererSoft::beginRenderPass(std::shared_ptr<FrameBuffer> &frameBuffer,
                                    const ClearStates &states)
 {
-    fbo_ = dynamic_cast<FrameBufferSoft *>(frameBuffer.get());
-
-    if (!fbo_)
+    auto *fbo = dynamic_cast<FrameBufferSoft *>(frameBuffer.get());
+    if (!fbo)
     {
+        recordPass_ = nullptr;
         return;
     }
 
-    fboColor_ = fbo_->getColorBuffer();
-    fboDepth_ = fbo_->getDepthBuffer();
-
-    if (states.colorFlag && fboColor_)
-    {
-        RGBA color = RGBA(states.clearColor.r * 255, states.clearColor.g * 255,
-                          states.clearColor.b * 255, states.clearColor.a * 255);
-        if (fboColor_->multiSample)
-        {
-            fboColor_->bufferMs4x->setAll(glm::tvec4<RGBA>(color));
-        }
-        else
-        {
-            fboColor_->buffer->setAll(color);
-        }
-    }
+    // attachments may be changed after this call, keep the current ones
+    recordPass_ = std::make_shared<RenderPassCommand>();
+    recordPass_->frameBuffer = frameBuffer;
+    recordPass_->colorBuffer = fbo->getColorBuffer();
+    recordPass_->depthBuffer = fbo->getDepthBuffer();
+    recordPass_->clearStates = states;
 
-    if (states.depthFlag && fboDepth_)
+    auto isReadExternally = [](const FrameBufferAttachment &attachment)
     {
-        if (fboDepth_->multiSample)
-        {
-            fboDepth_->bufferMs4x->setAll(glm::tvec4<float>(states.clearDepth));
-        }
-        else
-        {
-            fboDepth_->buffer->setAll(states.clearDepth);
-        }
-    }
+        return attachment.tex && !attachment.tex->multiSample &&
+               (attachment.tex->usage & (TextureUsage_Sampler | TextureUsage_RendererOutput));
+    };
+    recordPass_->resolveColorClear = isReadExternally(frameBuffer->getColorAttachment());
+    recordPass_->resolveDepthClear = isReadExternally(frameBuffer->getDepthAttachment());
 }
 
 void RendererSoft::setViewPort(int x, int y, int width, int height)
 {
-    viewport_.x = (float)x;
-    viewport_.y = (float)y;
-    viewport_.width = (float)width;
-    viewport_.height = (float)height;
-
-    viewport_.minDepth = 0.f;
-    viewport_.maxDepth = 1.f;
-
-    viewport_.absMinDepth = std::min(viewport_.minDepth, viewport_.maxDepth);
-    viewport_.absMaxDepth = std::max(viewport_.minDepth, viewport_.maxDepth);
-
-    viewport_.innerO.x = viewport_.x + viewport_.width / 2.f;
-    viewport_.innerO.y = viewport_.y + viewport_.height / 2.f;
-    viewport_.innerO.z = viewport_.minDepth;
-    viewport_.innerO.w = 0.f;
-
-    viewport_.innerP.x = viewport_.width / 2.f;  // divide by 2 in advance
-    viewport_.innerP.y = viewport_.height / 2.f; // divide by 2 in advance
-    viewport_.innerP.z = viewport_.maxDepth - viewport_.minDepth;
-    viewport_.innerP.w = 1.f;
+    Viewport &viewport = recordViewport_;
+    viewport.x = (float)x;
+    viewport.y = (float)y;
+    viewport.width = (float)width;
+    viewport.height = (float)height;
+
+    viewport.minDepth = 0.f;
+    viewport.maxDepth = 1.f;
+
+    viewport.absMinDepth = std::min(viewport.minDepth, viewport.maxDepth);
+    viewport.absMaxDepth = std::max(viewport.minDepth, viewport.maxDepth);
+
+    viewport.innerO.x = viewport.x + viewport.width / 2.f;
+    viewport.innerO.y = viewport.y + viewport.height / 2.f;
+    viewport.innerO.z = viewport.minDepth;
+    viewport.innerO.w = 0.f;
+
+    viewport.innerP.x = viewport.width / 2.f;  // divide by 2 in advance
+    viewport.innerP.y = viewport.height / 2.f; // divide by 2 in advance
+    viewport.innerP.z = viewport.maxDepth - viewport.minDepth;
+    viewport.innerP.w = 1.f;
 }
 
 void RendererSoft::setVertexArrayObject(std::shared_ptr<VertexArrayObject> &vao)
 {
-    vao_ = dynamic_cast<VertexArrayObjectSoft *>(vao.get());
+    recordVao_ = vao;
 }
 
 void RendererSoft::setShaderProgram(std::shared_ptr<ShaderProgram> &program)
 {
-    shaderProgram_ = dynamic_cast<ShaderProgramSoft *>(program.get());
+    recordProgram_ = std::dynamic_pointer_cast<ShaderProgramSoft>(program);
 }
 
 void RendererSoft::setShaderResources(std::shared_ptr<ShaderResources> &resources)
@@ -150,26 +232,145 @@ void RendererSoft::setShaderResources(std::shared_ptr<ShaderResources> &resource
     {
         return;
     }
-    if (shaderProgram_)
+    if (recordProgram_)
     {
-        shaderProgram_->bindResources(*resources);
+        recordProgram_->bindResources(*resources);
     }
 }
 
 void RendererSoft::setPipelineStates(std::shared_ptr<PipelineStates> &states)
 {
-    renderState_ = &states->renderStates;
+    recordStates_ = states;
 }
 
 void RendererSoft::draw()
 {
-    if (!fbo_ || !vao_ || !shaderProgram_)
+    if (!recordPass_ || !recordVao_ || !recordProgram_ || !recordStates_)
+    {
+        return;
+    }
+
+    // uniforms and samplers may be rebound before execution, snapshot them
+    DrawCommand cmd;
+    cmd.vao = recordVao_;
+    cmd.program = recordProgram_->snapshot();
+    cmd.states = recordStates_;
+    cmd.viewport = recordViewport_;
+
+    std::vector<uint8_t> &uniforms = recordPass_->uniforms;
+    cmd.uniformsOffset = uniforms.size();
+    uniforms.resize(cmd.uniformsOffset +
+                    MemoryUtils::alignedSize(recordProgram_->getShaderUniformsSize()));
+    recordProgram_->copyUniforms(uniforms.data() + cmd.uniformsOffset);
+    recordPass_->draws.push_back(std::move(cmd));
+}
+
+void RendererSoft::endRenderPass()
+{
+    if (!recordPass_)
+    {
+        return;
+    }
+
+    bool startExecute = false;
+    {
+        const std::lock_guard<std::mutex> lock(passesMutex_);
+        pendingPasses_.push_back(std::move(recordPass_));
+        startExecute = !executing_;
+        executing_ = true;
+    }
+    recordPass_ = nullptr;
+
+    if (startExecute)
+    {
+        executeGroup_.run([&](std::size_t threadId) { executeRenderPasses(); });
+    }
+}
+
+void RendererSoft::waitIdle()
+{
+    executeGroup_.wait();
+}
+
+void RendererSoft::executeRenderPasses()
+{
+    while (true)
+    {
+        std::shared_ptr<RenderPassCommand> pass;
+        {
+            const std::lock_guard<std::mutex> lock(passesMutex_);
+            if (pendingPasses_.empty())
+            {
+                executing_ = false;
+                return;
+            }
+            pass = std::move(pendingPasses_.front());
+            pendingPasses_.pop_front();
+        }
+        executeRenderPass(*pass);
+    }
+}
+
+void RendererSoft::executeRenderPass(RenderPassCommand &pass)
+{
+    fboColor_ = pass.colorBuffer;
+    fboDepth_ = pass.depthBuffer;
+    shadedVertexCnt_ = 0; // accumulated by the draws of this pass
+
+    if (fboColor_)
+    {
+        fboColor_->enableSamplesEqual();
+    }
+
+    // clears only mark tiles, tiles are filled when first rasterized
+    const ClearStates &states = pass.clearStates;
+    if (states.colorFlag && fboColor_)
+    {
+        RGBA color = RGBA(states.clearColor.r * 255, states.clearColor.g * 255,
+                          states.clearColor.b * 255, states.clearColor.a * 255);
+        fboColor_->clearLazy(color);
+    }
+
+    if (states.depthFlag && fboDepth_)
+    {
+        fboDepth_->clearLazy(states.clearDepth);
+        hiZReset(states.clearDepth, false);
+    }
+
+    for (auto &cmd : pass.draws)
+    {
+        cmd.program->bindUniformData(pass.uniforms.data() + cmd.uniformsOffset);
+        executeDraw(cmd);
+    }
+    flushDrawBatch();
+
+    if ((!pass.draws.empty() || states.colorFlag) && fboColor_ && fboColor_->multiSample)
+    {
+        multiSampleResolve();
+    }
+
+    // tiles never rasterized still hold the clear value only
+    if (pass.resolveColorClear)
+    {
+        resolveClear(fboColor_.get());
+    }
+    if (pass.resolveDepthClear)
+    {
+        resolveClear(fboDepth_.get());
+    }
+}
+
+void RendererSoft::executeDraw(DrawCommand &cmd)
+{
+    vao_ = dynamic_cast<VertexArrayObjectSoft *>(cmd.vao.get());
+    shaderProgram_ = cmd.program.get();
+    renderState_ = &cmd.states->renderStates;
+    viewport_ = cmd.viewport;
+    if (!vao_)
     {
         return;
     }
 
-    fboColor_ = fbo_->getColorBuffer();
-    fboDepth_ = fbo_->getDepthBuffer();
     primitiveType_ = renderState_->primitiveType;
 
     if (fboColor_)
@@ -184,27 +385,100 @@ void RendererSoft::draw()
     {
         rasterSamples_ = 1;
     }
+    rasterLanes_.Init(rasterSamples_);
+
+    // attachments not matching the raster sample count are not written
+    bool multiSample = rasterSamples_ > 1;
+    bool hasColor = fboColor_ && fboColor_->multiSample == multiSample;
+    bool hasDepth = fboDepth_ && fboDepth_->multiSample == multiSample;
+    auto *pipelineStates = dynamic_cast<PipelineStatesSoft *>(cmd.states.get());
+    if (pipelineStates)
+    {
+        pixelQuadKernel_ = pipelineStates->getPixelQuadKernel(hasColor, hasDepth, multiSample);
+    }
+    else
+    {
+        pixelQuadKernel_ = getPixelQuadKernel(
+            rasterKernelSpec(*renderState_, hasColor, hasDepth, multiSample));
+    }
+
+    // filled triangles without color output only need z, no varyings or fragment shading
+    depthStepKernel_ = nullptr;
+    if (!hasColor && hasDepth && primitiveType_ == Primitive_TRIANGLE &&
+        renderState_->polygonMode == PolygonMode_FILL && !shaderProgram_->fragmentShaderDiscard())
+    {
+        depthStepKernel_ = pipelineStates ? pipelineStates->getDepthStepKernel(multiSample)
+                                          : getDepthStepKernel(rasterKernelSpec(
+                                                *renderState_, false, true, multiSample));
+    }
+    varyingsHalf_ = shaderProgram_->isHalfVaryings() && !depthStepKernel_;
+    fragmentQuad_ = hasColor && !depthStepKernel_ && shaderProgram_->hasQuadFragmentShader();
+
+    // depth buffer changed, tile depth bounds unknown
+    if (fboDepth_ && fboDepth_ != hiZDepth_)
+    {
+        hiZReset(0.f, true);
+    }
 
     processVertexShader();
     processPrimitiveAssembly();
     processClipping();
-    processPerspectiveDivide();
-    processViewportTransform();
     processFaceCulling();
     processRasterization();
 
-    if (fboColor_ && fboColor_->multiSample)
+    if (batchDrawCnt_ >= batchMaxDraws_ ||
+        triangles_.size() + lines_.size() >= batchMaxPrimitives_)
     {
-        multiSampleResolve();
+        flushDrawBatch();
     }
 }
 
-void RendererSoft::endRenderPass()
+DrawContext &RendererSoft::currentDrawContext()
 {
+    if (batchDrawCnt_ >= drawContexts_.size())
+    {
+        drawContexts_.push_back(std::make_unique<DrawContext>());
+    }
+    DrawContext &draw = *drawContexts_[batchDrawCnt_];
+    draw.renderState = renderState_;
+    draw.viewport = viewport_;
+    draw.varyingsCnt = varyingsCnt_;
+    draw.varyingsHalf = varyingsHalf_;
+    draw.fragmentQuad = fragmentQuad_;
+    draw.hiZEnabled = false;
+    draw.pixelQuadKernel = pixelQuadKernel_;
+    draw.depthStepKernel = depthStepKernel_;
+    return draw;
 }
 
-void RendererSoft::waitIdle()
+void RendererSoft::flushDrawBatch()
 {
+    if (batchDrawCnt_ > 0)
+    {
+        // tile rasterization, primitives of one tile are rasterized by one thread in API order
+        auto rasterTiles = [&](std::size_t start, std::size_t end, std::size_t threadId)
+        {
+            for (std::size_t idx = start; idx < end; idx++)
+            {
+                if (tileBins_[idx].empty())
+                {
+                    continue;
+                }
+                rasterizationTile((int)idx % tileCntX_, (int)idx / tileCntX_, threadId);
+            }
+        };
+        const std::size_t tileCnt = (std::size_t)tileCntX_ * tileCntY_;
+#ifdef RASTER_MULTI_THREAD
+        threadPool_.parallelFor(0, tileCnt, 1, rasterTiles);
+#else
+        rasterTiles(0, tileCnt, 0);
+#endif
+    }
+
+    batchDrawCnt_ = 0;
+    triangles_.clear();
+    lines_.clear();
+    clippingArena_.reset();
 }
 
 void RendererSoft::processVertexShader()
@@ -213,22 +487,136 @@ void RendererSoft::processVertexShader()
     varyingsCnt_ = shaderProgram_->getShaderVaryingsSize() / sizeof(float);
     varyingsAlignedSize_ = MemoryUtils::alignedSize(varyingsCnt_ * sizeof(float));
     varyingsAlignedCnt_ = varyingsAlignedSize_ / sizeof(float);
+    varyingsStoreCnt_ =
+        varyingsHalf_ ? MemoryUtils::alignedSize(varyingsCnt_ * sizeof(uint16_t)) / sizeof(float)
+                      : varyingsAlignedCnt_;
 
-    varyings_ = MemoryUtils::makeAlignedBuffer<float>(vao_->vertexCnt * varyingsAlignedCnt_);
-    float *varyingBuffer = varyings_.get();
-
-    uint8_t *vertexPtr = vao_->vertexes.data();
+    // varyings are never read by depth only draws, vertexes share per thread scratch storage
+    if (depthStepKernel_)
+    {
+        varyings_ = nullptr;
+    }
+    else
+    {
+        varyings_ = MemoryUtils::makeAlignedBuffer<float>(vao_->vertexCnt * varyingsStoreCnt_);
+    }
     vertexes_.resize(vao_->vertexCnt);
-    for (int idx = 0; idx < vao_->vertexCnt; idx++)
+
+    // wide shading gathers attributes as floats from the vertex buffer
+    attributesCnt_ = shaderProgram_->getShaderAttributesSize() / sizeof(float);
+    vertexWide_ = shaderProgram_->hasWideVertexShader() &&
+                  attributesCnt_ * sizeof(float) <= vao_->vertexStride &&
+                  vao_->vertexStride % sizeof(float) == 0;
+
+    // only vertexes referenced by primitives need shading
+    markReferencedVertexes();
+
+    // per thread shader program
+    prepareThreadContexts();
+
+    // vertex shader, clip mask, perspective divide and viewport transform in one pass
+    const std::size_t vertexCnt = vao_->vertexCnt;
+#ifdef RASTER_MULTI_THREAD
+    threadPool_.parallelFor(0, vertexCnt, vertexChunkSize_,
+                            [&](std::size_t start, std::size_t end, std::size_t threadId)
+                            { processVertexShaderChunk(start, end, threadQuadCtx_[threadId]); });
+#else
+    for (std::size_t start = 0; start < vertexCnt; start += vertexChunkSize_)
+    {
+        std::size_t end = std::min(start + vertexChunkSize_, vertexCnt);
+        processVertexShaderChunk(start, end, threadQuadCtx_[0]);
+    }
+#endif
+}
+
+void RendererSoft::markReferencedVertexes()
+{
+    std::size_t primitiveVertexCnt = 3;
+    switch (primitiveType_)
+    {
+    case Primitive_POINT: primitiveVertexCnt = 1; break;
+    case Primitive_LINE: primitiveVertexCnt = 2; break;
+    case Primitive_TRIANGLE: primitiveVertexCnt = 3; break;
+    }
+
+    vertexReferenced_.assign(vao_->vertexCnt, 0);
+    lastShadedVertex_ = 0;
+
+    std::size_t indicesCnt = vao_->indicesCnt / primitiveVertexCnt * primitiveVertexCnt;
+    for (std::size_t i = 0; i < indicesCnt; i++)
+    {
+        auto idx = (std::size_t)vao_->indices[i];
+        if (idx < vao_->vertexCnt && !vertexReferenced_[idx])
+        {
+            vertexReferenced_[idx] = 1;
+            shadedVertexCnt_++;
+            lastShadedVertex_ = std::max(lastShadedVertex_, idx);
+        }
+    }
+}
+
+void RendererSoft::processVertexShaderChunk(std::size_t start, std::size_t end,
+                                            PixelQuadContext &ctx)
+{
+    ShaderProgramSoft *program = ctx.shaderProgram.get();
+    float *varyingBuffer = varyings_.get();
+    uint8_t *vertexPtr = vao_->vertexes.data() + start * vao_->vertexStride;
+    VertexBlock block;
+    for (std::size_t idx = start; idx < end; idx++)
     {
         VertexHolder &holder = vertexes_[idx];
-        holder.discard = false;
+        holder.discard = !vertexReferenced_[idx];
         holder.index = idx;
         holder.vertex = vertexPtr;
-        holder.varyings =
-            (varyingsAlignedSize_ > 0) ? (varyingBuffer + idx * varyingsAlignedCnt_) : nullptr;
-        vertexShaderImpl(holder);
+        if (varyingsAlignedSize_ == 0)
+        {
+            holder.varyings = nullptr;
+        }
+        else
+        {
+            holder.varyings = varyingBuffer ? (varyingBuffer + idx * varyingsStoreCnt_)
+                                            : ctx.pixels[0].varyingsFrag;
+        }
         vertexPtr += vao_->vertexStride;
+        if (holder.discard)
+        {
+            continue;
+        }
+
+        // shaded vertexes are packed without gaps for post-processing, wide shading runs on
+        // the packed vertexes once the block is full
+        if (vertexWide_)
+        {
+            block.index[block.count++] = idx;
+        }
+        else
+        {
+            vertexShaderImpl(holder, program, ctx.pixels[0].varyingsFrag);
+            block.add(idx, holder.clipPos);
+        }
+        if (block.count == VERTEX_BLOCK_SIZE)
+        {
+            if (vertexWide_)
+            {
+                vertexShaderWide(block, ctx);
+            }
+            vertexPostProcessing(block);
+            block.count = 0;
+        }
+    }
+    if (block.count > 0)
+    {
+        if (vertexWide_)
+        {
+            vertexShaderWide(block, ctx);
+        }
+        vertexPostProcessing(block);
+    }
+
+    // point size of the last shaded vertex
+    if (start <= lastShadedVertex_ && lastShadedVertex_ < end)
+    {
+        pointSize_ = program->getShaderBuiltin().PointSize;
     }
 }
 
@@ -244,6 +632,7 @@ void RendererSoft::processPrimitiveAssembly()
 
 void RendererSoft::processClipping()
 {
+    appendPrimitives_.clear();
     std::size_t primitiveCnt = primitives_.size();
     for (int i = 0; i < primitiveCnt; i++)
     {
@@ -262,64 +651,11 @@ void RendererSoft::processClipping()
             {
                 continue;
             }
-            std::vector<PrimitiveHolder> appendPrimitives;
-            clippingTriangle(primitive, appendPrimitives);
-            primitives_.insert(primitives_.end(), appendPrimitives.begin(), appendPrimitives.end());
-            break;
-        }
-    }
-
-    // set all vertexes discard flag to true
-    for (auto &vertex : vertexes_)
-    {
-        vertex.discard = true;
-    }
-
-    // set discard flag to false base on primitive discard flag
-    for (auto &primitive : primitives_)
-    {
-        if (primitive.discard)
-        {
-            continue;
-        }
-        switch (primitiveType_)
-        {
-        case Primitive_POINT: vertexes_[primitive.indices[0]].discard = false; break;
-        case Primitive_LINE:
-            vertexes_[primitive.indices[0]].discard = false;
-            vertexes_[primitive.indices[1]].discard = false;
+            clippingTriangle(primitive, appendPrimitives_);
             break;
-        case Primitive_TRIANGLE:
-            vertexes_[primitive.indices[0]].discard = false;
-            vertexes_[primitive.indices[1]].discard = false;
-            vertexes_[primitive.indices[2]].discard = false;
-            break;
-        }
-    }
-}
-
-void RendererSoft::processPerspectiveDivide()
-{
-    for (auto &vertex : vertexes_)
-    {
-        if (vertex.discard)
-        {
-            continue;
-        }
-        perspectiveDivideImpl(vertex);
-    }
-}
-
-void RendererSoft::processViewportTransform()
-{
-    for (auto &vertex : vertexes_)
-    {
-        if (vertex.discard)
-        {
-            continue;
         }
-        viewportTransformImpl(vertex);
     }
+    primitives_.insert(primitives_.end(), appendPrimitives_.begin(), appendPrimitives_.end());
 }
 
 void RendererSoft::processFaceCulling()
@@ -351,63 +687,95 @@ void RendererSoft::processFaceCulling()
     }
 }
 
-void RendererSoft::processRasterization()
+void RendererSoft::prepareThreadContexts()
 {
-    switch (primitiveType_)
+    // points and lines shade single pixels, their derivatives are zero
+    bool quadShading =
+        primitiveType_ == Primitive_TRIANGLE && renderState_->polygonMode == PolygonMode_FILL;
+
+    threadQuadCtx_.resize(threadPool_.getThreadCnt());
+    for (auto &ctx : threadQuadCtx_)
     {
-    case Primitive_POINT:
-        for (auto &primitive : primitives_)
+        ctx.SetVaryingsSize(varyingsAlignedCnt_);
+        ctx.Init(0.f, 0.f, rasterSamples_); // quads are moved in place while rasterizing
+        if (vertexWide_)
         {
-            if (primitive.discard)
-            {
-                continue;
-            }
-            auto *vert0 = &vertexes_[primitive.indices[0]];
-            rasterizationPoint(vert0, pointSize_);
+            ctx.SetVertexWideSize(attributesCnt_, varyingsCnt_);
         }
-        break;
-    case Primitive_LINE:
-        for (auto &primitive : primitives_)
-        {
+        ctx.shaderProgram = shaderProgram_->clone(depthStepKernel_ == nullptr);
+
+        // setup derivative
+        DerivativeContext &df_ctx = ctx.shaderProgram->getShaderBuiltin().dfCtx;
+        df_ctx.p0 = ctx.pixels[0].varyingsFrag;
+        df_ctx.p1 = ctx.pixels[quadShading ? 1 : 0].varyingsFrag;
+        df_ctx.p2 = ctx.pixels[quadShading ? 2 : 0].varyingsFrag;
+        df_ctx.p3 = ctx.pixels[quadShading ? 3 : 0].varyingsFrag;
+    }
+}
+
+void RendererSoft::processRasterization()
+{
+    if (!depthStepKernel_)
+    {
+        for (auto &ctx : threadQuadCtx_)
+        {
+            ctx.shaderProgram->prepareFragmentShader();
+        }
+    }
+
+    rasterizationBatchBegin();
+    DrawContext &draw = currentDrawContext();
+
+    // viewport pixels inside the framebuffer, primitive bounds are clamped to them
+    int width = fboColor_ ? fboColor_->width : fboDepth_->width;
+    int height = fboColor_ ? fboColor_->height : fboDepth_->height;
+    rasterBounds_.min = glm::vec3(std::max(viewport_.x, 0.f), std::max(viewport_.y, 0.f), 0.f);
+    rasterBounds_.max = glm::vec3(std::min(viewport_.x + viewport_.width, (float)width) - 1.f,
+                                  std::min(viewport_.y + viewport_.height, (float)height) - 1.f,
+                                  0.f);
+    switch (primitiveType_)
+    {
+    case Primitive_POINT:
+        for (auto &primitive : primitives_)
+        {
             if (primitive.discard)
             {
                 continue;
             }
             auto *vert0 = &vertexes_[primitive.indices[0]];
-            auto *vert1 = &vertexes_[primitive.indices[1]];
-            rasterizationLine(vert0, vert1, renderState_->lineWidth);
+            lineSetup(vert0, vert0, pointSize_, true);
         }
         break;
-    case Primitive_TRIANGLE:
-        threadQuadCtx_.resize(threadPool_.getThreadCnt());
-        for (auto &ctx : threadQuadCtx_)
+    case Primitive_LINE:
+        for (auto &primitive : primitives_)
         {
-            ctx.SetVaryingsSize(varyingsAlignedCnt_);
-            ctx.shaderProgram = shaderProgram_->clone();
-            ctx.shaderProgram->prepareFragmentShader();
-
-            // setup derivative
-            DerivativeContext &df_ctx = ctx.shaderProgram->getShaderBuiltin().dfCtx;
-            df_ctx.p0 = ctx.pixels[0].varyingsFrag;
-            df_ctx.p1 = ctx.pixels[1].varyingsFrag;
-            df_ctx.p2 = ctx.pixels[2].varyingsFrag;
-            df_ctx.p3 = ctx.pixels[3].varyingsFrag;
+            if (primitive.discard)
+            {
+                continue;
+            }
+            auto *vert0 = &vertexes_[primitive.indices[0]];
+            auto *vert1 = &vertexes_[primitive.indices[1]];
+            lineSetup(vert0, vert1, renderState_->lineWidth, true);
         }
-        rasterizationPolygons(primitives_);
-        threadPool_.waitTasksFinish();
+        break;
+    case Primitive_TRIANGLE:
+        rasterizationPolygons(primitives_, draw);
         break;
     }
+    rasterizationBatchEnd(draw);
 }
 
 void RendererSoft::processFragmentShader(glm::vec4 &screenPos, bool front_facing, void *varyings,
                                          ShaderProgramSoft *shader)
 {
-    if (!fboColor_)
+    // without color output only a possible discard makes the shader observable
+    auto &builtin = shader->getShaderBuiltin();
+    builtin.discard = false;
+    if (!fboColor_ && !shader->fragmentShaderDiscard())
     {
         return;
     }
 
-    auto &builtin = shader->getShaderBuiltin();
     builtin.FragCoord = screenPos;
     builtin.FrontFacing = front_facing;
 
@@ -416,10 +784,10 @@ void RendererSoft::processFragmentShader(glm::vec4 &screenPos, bool front_facing
 }
 
 void RendererSoft::processPerSampleOperations(int x, int y, float depth, const glm::vec4 &color,
-                                              int sample)
+                                              int sample, DrawContext &draw)
 {
     // depth test
-    if (!processDepthTest(x, y, depth, sample, false))
+    if (!processDepthTest(x, y, depth, sample, false, draw))
     {
         return;
     }
@@ -432,39 +800,43 @@ void RendererSoft::processPerSampleOperations(int x, int y, float depth, const g
     glm::vec4 color_clamp = glm::clamp(color, 0.f, 1.f);
 
     // color blending
-    processColorBlending(x, y, color_clamp, sample);
+    processColorBlending(x, y, color_clamp, sample, draw);
 
     // write final color to fbo
     setFrameColor(x, y, color_clamp * 255.f, sample);
 }
 
-bool RendererSoft::processDepthTest(int x, int y, float depth, int sample, bool skipWrite)
+bool RendererSoft::processDepthTest(int x, int y, float depth, int sample, bool skipWrite,
+                                    DrawContext &draw)
 {
-    if (!renderState_->depthTest || !fboDepth_)
+    const RenderStates &states = *draw.renderState;
+    if (!states.depthTest || !fboDepth_)
     {
         return true;
     }
 
     // depth clamping
-    depth = glm::clamp(depth, viewport_.absMinDepth, viewport_.absMaxDepth);
+    depth = glm::clamp(depth, draw.viewport.absMinDepth, draw.viewport.absMaxDepth);
 
     // depth comparison
     float *zPtr = getFrameDepth(x, y, sample);
-    if (zPtr && DepthTest(depth, *zPtr, renderState_->depthFunc))
+    if (zPtr && DepthTest(depth, *zPtr, states.depthFunc))
     {
         // depth attachment writes
-        if (!skipWrite && renderState_->depthMask)
+        if (!skipWrite && states.depthMask)
         {
             *zPtr = depth;
+            hiZWrite(x, y, depth);
         }
         return true;
     }
     return false;
 }
 
-void RendererSoft::processColorBlending(int x, int y, glm::vec4 &color, int sample)
+void RendererSoft::processColorBlending(int x, int y, glm::vec4 &color, int sample,
+                                        DrawContext &draw)
 {
-    if (renderState_->blend)
+    if (draw.renderState->blend)
     {
         glm::vec4 &srcColor = color;
         glm::vec4 dstColor = glm::vec4(0.f);
@@ -473,7 +845,7 @@ void RendererSoft::processColorBlending(int x, int y, glm::vec4 &color, int samp
         {
             dstColor = glm::vec4(*ptr) / 255.f;
         }
-        color = calcBlendColor(srcColor, dstColor, renderState_->blendParams);
+        color = calcBlendColor(srcColor, dstColor, draw.renderState->blendParams);
     }
 }
 
@@ -518,7 +890,7 @@ void RendererSoft::clippingPoint(PrimitiveHolder &point)
     point.discard = (vertexes_[point.indices[0]].clipMask != 0);
 }
 
-void RendererSoft::clippingLine(PrimitiveHolder &line, bool postVertexProcess)
+void RendererSoft::clippingLine(PrimitiveHolder &line)
 {
     VertexHolder *v0 = &vertexes_[line.indices[0]];
     VertexHolder *v1 = &vertexes_[line.indices[1]];
@@ -569,12 +941,12 @@ void RendererSoft::clippingLine(PrimitiveHolder &line, bool postVertexProcess)
     if (clipMaskV0)
     {
         line.indices[0] =
-            clippingNewVertex(line.indices[0], line.indices[1], t0, postVertexProcess);
+            clippingNewVertex(line.indices[0], line.indices[1], t0);
     }
     if (clipMaskV1)
     {
         line.indices[1] =
-            clippingNewVertex(line.indices[0], line.indices[1], t1, postVertexProcess);
+            clippingNewVertex(line.indices[0], line.indices[1], t1);
     }
 }
 
@@ -591,44 +963,64 @@ void RendererSoft::clippingTriangle(PrimitiveHolder &triangle,
         return;
     }
 
-    bool fullClip = false;
-    std::vector<std::size_t> indicesIn;
-    std::vector<std::size_t> indicesOut;
+    // trivial reject, all vertexes outside the same plane
+    if (v0->clipMask & v1->clipMask & v2->clipMask)
+    {
+        triangle.discard = true;
+        return;
+    }
+
+    // only near/far and guard band planes need geometric clipping,
+    // the rest is handled by bounding box clamp in rasterization
+    mask &= (FrustumClipMask::POSITIVE_Z | FrustumClipMask::NEGATIVE_Z);
+    mask |= countGuardBandClipMask(v0->clipPos) | countGuardBandClipMask(v1->clipPos) |
+            countGuardBandClipMask(v2->clipPos);
+    if (mask == 0)
+    {
+        return;
+    }
+
+    // each plane adds at most one vertex, 3 + 6 planes + 1 for closing the loop
+    std::size_t indicesBuffer[2][12];
+    std::size_t *indicesIn = indicesBuffer[0];
+    std::size_t *indicesOut = indicesBuffer[1];
+    int cntIn = 3;
+    int cntOut = 0;
 
-    indicesIn.push_back(v0->index);
-    indicesIn.push_back(v1->index);
-    indicesIn.push_back(v2->index);
+    indicesIn[0] = v0->index;
+    indicesIn[1] = v1->index;
+    indicesIn[2] = v2->index;
 
     for (int planeIdx = 0; planeIdx < 6; planeIdx++)
     {
         if (mask & FrustumClipMaskArray[planeIdx])
         {
-            if (indicesIn.size() < 3)
+            if (cntIn < 3)
             {
-                fullClip = true;
                 break;
             }
-            indicesOut.clear();
+            cntOut = 0;
+            const glm::vec4 &plane =
+                planeIdx < 4 ? GuardBandClipPlane[planeIdx] : FrustumClipPlane[planeIdx];
             std::size_t idxPre = indicesIn[0];
-            float dPre = glm::dot(FrustumClipPlane[planeIdx], vertexes_[idxPre].clipPos);
+            float dPre = glm::dot(plane, vertexes_[idxPre].clipPos);
 
-            indicesIn.push_back(idxPre);
-            for (int i = 1; i < indicesIn.size(); i++)
+            indicesIn[cntIn] = idxPre;
+            for (int i = 1; i <= cntIn; i++)
             {
                 std::size_t idx = indicesIn[i];
-                float d = glm::dot(FrustumClipPlane[planeIdx], vertexes_[idx].clipPos);
+                float d = glm::dot(plane, vertexes_[idx].clipPos);
 
                 if (dPre >= 0)
                 {
-                    indicesOut.push_back(idxPre);
+                    indicesOut[cntOut++] = idxPre;
                 }
 
                 if (std::signbit(dPre) != std::signbit(d))
                 {
                     float t = d < 0 ? dPre / (dPre - d) : -dPre / (d - dPre);
                     // create new vertex
-                    auto vertIdx = clippingNewVertex(idxPre, idx, t);
-                    indicesOut.push_back(vertIdx);
+                    indicesOut[cntOut++] = clippingNewVertex(idxPre, idx, t);
                 }
 
                 idxPre = idx;
@@ -636,10 +1028,11 @@ void RendererSoft::clippingTriangle(PrimitiveHolder &triangle,
             }
 
             std::swap(indicesIn, indicesOut);
+            cntIn = cntOut;
         }
     }
 
-    if (fullClip || indicesIn.empty())
+    if (cntIn < 3)
     {
         triangle.discard = true;
         return;
@@ -649,7 +1042,7 @@ void RendererSoft::clippingTriangle(PrimitiveHolder &triangle,
     triangle.indices[1] = indicesIn[1];
     triangle.indices[2] = indicesIn[2];
 
-    for (int i = 3; i < indicesIn.size(); i++)
+    for (int i = 3; i < cntIn; i++)
     {
         appendPrimitives.emplace_back();
         PrimitiveHolder &ph = appendPrimitives.back();
@@ -661,17 +1054,19 @@ void RendererSoft::clippingTriangle(PrimitiveHolder &triangle,
     }
 }
 
-void RendererSoft::rasterizationPolygons(std::vector<PrimitiveHolder> &primitives)
+void RendererSoft::rasterizationPolygons(std::vector<PrimitiveHolder> &primitives,
+                                         DrawContext &draw)
 {
     switch (renderState_->polygonMode)
     {
-    case PolygonMode_POINT: rasterizationPolygonsPoint(primitives); break;
-    case PolygonMode_LINE: rasterizationPolygonsLine(primitives); break;
-    case PolygonMode_FILL: rasterizationPolygonsTriangle(primitives); break;
+    case PolygonMode_POINT: rasterizationPolygonsPoint(primitives, draw); break;
+    case PolygonMode_LINE: rasterizationPolygonsLine(primitives, draw); break;
+    case PolygonMode_FILL: rasterizationPolygonsTriangle(primitives, draw); break;
     }
 }
 
-void RendererSoft::rasterizationPolygonsPoint(std::vector<PrimitiveHolder> &primitives)
+void RendererSoft::rasterizationPolygonsPoint(std::vector<PrimitiveHolder> &primitives,
+                                              DrawContext &draw)
 {
     for (auto &triangle : primitives)
     {
@@ -693,22 +1088,44 @@ void RendererSoft::rasterizationPolygonsPoint(std::vector<PrimitiveHolder> &prim
                 continue;
             }
 
-            // rasterization
-            rasterizationPoint(&vertexes_[point.indices[0]], pointSize_);
+            // setup & binning
+            auto *vert0 = &vertexes_[point.indices[0]];
+            lineSetup(vert0, vert0, pointSize_, point.frontFacing);
         }
     }
 }
 
-void RendererSoft::rasterizationPolygonsLine(std::vector<PrimitiveHolder> &primitives)
+void RendererSoft::rasterizationPolygonsLine(std::vector<PrimitiveHolder> &primitives,
+                                             DrawContext &draw)
 {
-    for (auto &triangle : primitives)
+    // triangles are not clipped in line mode, primitives map to the index buffer one to one
+    const VertexArrayObjectSoft::EdgeSharers &sharers = vao_->getEdgeSharers();
+    for (std::size_t triangleIdx = 0; triangleIdx < primitives.size(); triangleIdx++)
     {
+        auto &triangle = primitives[triangleIdx];
         if (triangle.discard)
         {
             continue;
         }
         for (std::size_t i = 0; i < 3; i++)
         {
+            // shared edges are drawn once, by the first sharer in triangle order not culled
+            std::size_t edge = triangleIdx * 3 + i;
+            std::size_t drawer = triangleIdx;
+            for (uint32_t pos = sharers.begin[edge]; pos < sharers.end[edge]; pos++)
+            {
+                std::size_t sharer = sharers.edges[pos] / 3;
+                if (!primitives[sharer].discard)
+                {
+                    drawer = sharer;
+                    break;
+                }
+            }
+            if (drawer != triangleIdx)
+            {
+                continue;
+            }
+
             PrimitiveHolder line;
             line.discard = false;
             line.frontFacing = triangle.frontFacing;
@@ -716,325 +1133,1438 @@ void RendererSoft::rasterizationPolygonsLine(std::vector<PrimitiveHolder> &primi
             line.indices[1] = triangle.indices[(i + 1) % 3];
 
             // clipping
-            clippingLine(line, true);
+            clippingLine(line);
             if (line.discard)
             {
                 continue;
             }
 
-            // rasterization
-            rasterizationLine(&vertexes_[line.indices[0]], &vertexes_[line.indices[1]],
-                              renderState_->lineWidth);
+            // setup & binning
+            lineSetup(&vertexes_[line.indices[0]], &vertexes_[line.indices[1]],
+                      renderState_->lineWidth, line.frontFacing);
         }
     }
 }
 
-void RendererSoft::rasterizationPolygonsTriangle(std::vector<PrimitiveHolder> &primitives)
+void RendererSoft::rasterizationPolygonsTriangle(std::vector<PrimitiveHolder> &primitives,
+                                                 DrawContext &draw)
 {
+    // hierarchical z, depth bounds share the rasterization tile grid
+    draw.hiZEnabled = renderState_->depthTest && fboDepth_ && fboDepth_ == hiZDepth_ &&
+                      hiZTileCntX_ == tileCntX_ && hiZTileCntY_ == tileCntY_;
+
+    // triangle setup & binning
     for (auto &triangle : primitives)
     {
         if (triangle.discard)
         {
             continue;
         }
-        rasterizationTriangle(&vertexes_[triangle.indices[0]], &vertexes_[triangle.indices[1]],
-                              &vertexes_[triangle.indices[2]], triangle.frontFacing);
+        triangleSetup(triangle);
     }
 }
 
-void RendererSoft::rasterizationPoint(VertexHolder *v, float pointSize)
+void RendererSoft::rasterizationBatchBegin()
 {
-    if (!fboColor_)
+    if (batchDrawCnt_ > 0)
+    {
+        return;
+    }
+
+    // tile grid over the framebuffer, shared by all draws of the batch
+    int width = fboColor_ ? fboColor_->width : fboDepth_->width;
+    int height = fboColor_ ? fboColor_->height : fboDepth_->height;
+    tileCntX_ = (width + rasterTileSize_ - 1) / rasterTileSize_;
+    tileCntY_ = (height + rasterTileSize_ - 1) / rasterTileSize_;
+    tileBins_.resize(tileCntX_ * tileCntY_);
+    for (auto &bin : tileBins_)
     {
+        bin.clear();
+    }
+    triangles_.clear();
+    lines_.clear();
+}
+
+void RendererSoft::rasterizationBatchEnd(DrawContext &draw)
+{
+    // primitive setups point into vertex shader output, keep it until the batch is rasterized,
+    // swapping hands the buffers of an already rasterized draw back for reuse
+    std::swap(draw.vertexes, vertexes_);
+    std::swap(draw.varyings, varyings_);
+    std::swap(draw.threadQuadCtx, threadQuadCtx_);
+    batchDrawCnt_++;
+}
+
+void RendererSoft::triangleSetup(PrimitiveHolder &triangle)
+{
+    TriangleSetup &setup = triangles_.setups.emplace_back();
+    if (!triangleSetupEdges(setup, triangle))
+    {
+        triangles_.setups.pop_back();
         return;
     }
 
-    float left = v->fragPos.x - pointSize / 2.f + 0.5f;
-    float right = left + pointSize;
-    float top = v->fragPos.y - pointSize / 2.f + 0.5f;
-    float bottom = top + pointSize;
+    glm::aligned_vec4 *pos = setup.vertPos;
+    triangles_.drawIdx.push_back((uint32_t)batchDrawCnt_);
+    triangles_.minZ.push_back(std::min(std::min(pos[0].z, pos[1].z), pos[2].z) - 1e-6f);
+    triangles_.maxZ.push_back(std::max(std::max(pos[0].z, pos[1].z), pos[2].z) + 1e-6f);
+    primitiveBinning(setup.bounds, (triangles_.size() - 1) << 1);
+}
+
+// sample locations inside a pixel for the raster sample count
+static inline const glm::vec2 *rasterSampleLocations(int sampleCnt)
+{
+    static glm::vec2 center = {0.5f, 0.5f};
+    return sampleCnt > 1 ? PixelContext::GetSampleLocation4X() : &center;
+}
 
-    glm::vec4 &screenPos = v->fragPos;
-    for (int x = (int)left; x < (int)right; x++)
+// whether a sample row or column lies in the snapped range [minF, maxF] of one axis
+static inline bool snappedRangeHasSample(int64_t minF, int64_t maxF, int sampleCnt, int axis)
+{
+    const int64_t pixel = 1 << RASTER_SUBPIXEL_BITS;
+    if (maxF - minF >= pixel)
+    {
+        return true;
+    }
+    const glm::vec2 *locations = rasterSampleLocations(sampleCnt);
+    for (int s = 0; s < std::max(sampleCnt, 1); s++)
     {
-        for (int y = (int)top; y < (int)bottom; y++)
+        // first sample position at or after minF
+        int64_t offset = (int64_t)(locations[s][axis] * (float)pixel);
+        int64_t pos = minF + ((offset - minF) % pixel + pixel) % pixel;
+        if (pos <= maxF)
         {
-            screenPos.x = (float)x;
-            screenPos.y = (float)y;
-            processFragmentShader(screenPos, true, v->varyings, shaderProgram_);
-            auto &builtIn = shaderProgram_->getShaderBuiltin();
-            if (!builtIn.discard)
-            {
-                // TODO MSAA
-                for (int idx = 0; idx < rasterSamples_; idx++)
-                {
-                    processPerSampleOperations(x, y, screenPos.z, builtIn.FragColor, idx);
-                }
-            }
+            return true;
         }
     }
+    return false;
 }
 
-void RendererSoft::rasterizationLine(VertexHolder *v0, VertexHolder *v1, float lineWidth)
+bool RendererSoft::triangleSetupEdges(TriangleSetup &setup, PrimitiveHolder &triangle)
 {
-    // TODO diamond-exit rule
-    int x0 = (int)v0->fragPos.x, y0 = (int)v0->fragPos.y;
-    int x1 = (int)v1->fragPos.x, y1 = (int)v1->fragPos.y;
+    VertexHolder *vert[3] = {&vertexes_[triangle.indices[0]], &vertexes_[triangle.indices[1]],
+                             &vertexes_[triangle.indices[2]]};
+
+    setup.frontFacing = triangle.frontFacing;
+    for (int i = 0; i < 3; i++)
+    {
+        setup.vertPos[i] = vert[i]->fragPos;
+        setup.vertZ[i] = vert[i]->fragPos.z;
+        setup.vertW[i] = vert[i]->fragPos.w;
+        setup.vertVaryings[i] = vert[i]->varyings;
+    }
+
+    // fixed-point vertex position
+    int64_t fx[3], fy[3];
+    for (int i = 0; i < 3; i++)
+    {
+        fx[i] = std::llround(setup.vertPos[i].x * (1 << RASTER_SUBPIXEL_BITS));
+        fy[i] = std::llround(setup.vertPos[i].y * (1 << RASTER_SUBPIXEL_BITS));
+    }
 
-    float z0 = v0->fragPos.z;
-    float z1 = v1->fragPos.z;
+    // tiny triangles with snapped bounds between sample rows or columns cover nothing
+    if (!snappedRangeHasSample(std::min({fx[0], fx[1], fx[2]}), std::max({fx[0], fx[1], fx[2]}),
+                               rasterSamples_, 0) ||
+        !snappedRangeHasSample(std::min({fy[0], fy[1], fy[2]}), std::max({fy[0], fy[1], fy[2]}),
+                               rasterSamples_, 1))
+    {
+        return false;
+    }
 
-    float w0 = v0->fragPos.w;
-    float w1 = v1->fragPos.w;
+    // edge functions
+    int64_t area = 0;
+    for (int i = 0; i < 3; i++)
+    {
+        int i1 = (i + 1) % 3;
+        int i2 = (i + 2) % 3;
+        setup.edgeA[i] = fy[i1] - fy[i2];
+        setup.edgeB[i] = fx[i2] - fx[i1];
+        setup.edgeC[i] = fx[i1] * fy[i2] - fx[i2] * fy[i1];
+        area += setup.edgeC[i];
+    }
+    if (area == 0)
+    {
+        return false;
+    }
 
-    bool steep = false;
-    if (std::abs(x0 - x1) < std::abs(y0 - y1))
+    // make inside positive
+    if (area < 0)
     {
-        std::swap(x0, y0);
-        std::swap(x1, y1);
-        steep = true;
+        area = -area;
+        for (int i = 0; i < 3; i++)
+        {
+            setup.edgeA[i] = -setup.edgeA[i];
+            setup.edgeB[i] = -setup.edgeB[i];
+            setup.edgeC[i] = -setup.edgeC[i];
+        }
     }
 
-    const float *varyingsIn[2] = {v0->varyings, v1->varyings};
+    // barycentric gradients
+    glm::aligned_vec4 *pos = setup.vertPos;
+    float areaF = (pos[1].y - pos[2].y) * (pos[0].x - pos[1].x) +
+                  (pos[2].x - pos[1].x) * (pos[0].y - pos[1].y);
+    if (std::abs(areaF) < FLT_EPSILON)
+    {
+        return false;
+    }
+    for (int i = 0; i < 3; i++)
+    {
+        int i1 = (i + 1) % 3;
+        int i2 = (i + 2) % 3;
+        setup.baryDx[i] = (pos[i1].y - pos[i2].y) / areaF;
+        setup.baryDy[i] = (pos[i2].x - pos[i1].x) / areaF;
+    }
 
-    if (x0 > x1)
+    // top-left rule (y up): left edge has interior on its right,
+    // top edge is horizontal with interior below
+    for (int i = 0; i < 3; i++)
     {
-        std::swap(x0, x1);
-        std::swap(y0, y1);
-        std::swap(z0, z1);
-        std::swap(w0, w1);
-        std::swap(varyingsIn[0], varyingsIn[1]);
+        bool topLeft = setup.edgeA[i] > 0 || (setup.edgeA[i] == 0 && setup.edgeB[i] < 0);
+        setup.edgeBias[i] = topLeft ? 1 : 0;
     }
-    int dx = x1 - x0;
-    int dy = y1 - y0;
 
-    int error = 0;
-    int dError = 2 * std::abs(dy);
+    setup.bounds = triangleBoundingBox(setup.vertPos, rasterBounds_);
+
+    // bounds fit in one raster step wide and two quad rows high inside a single tile
+    BoundingBox &bounds = setup.bounds;
+    int x0 = (int)bounds.min.x & ~1;
+    int y0 = (int)bounds.min.y & ~1;
+    int x1 = (int)bounds.max.x;
+    int y1 = (int)bounds.max.y;
+    setup.micro = bounds.max.x >= bounds.min.x && bounds.max.y >= bounds.min.y &&
+                  x1 - x0 < rasterLanes_.quadCnt * 2 && y1 - y0 < 4 &&
+                  x0 / rasterTileSize_ == x1 / rasterTileSize_ &&
+                  y0 / rasterTileSize_ == y1 / rasterTileSize_;
+    return true;
+}
+
+void RendererSoft::lineSetup(VertexHolder *v0, VertexHolder *v1, float width, bool frontFacing)
+{
+    lines_.emplace_back();
+    LineSetup &setup = lines_.back();
+    setup.vertPos[0] = v0->fragPos;
+    setup.vertPos[1] = v1->fragPos;
+    setup.vertVaryings[0] = v0->varyings;
+    setup.vertVaryings[1] = v1->varyings;
+    setup.width = std::max(width, 1.f);
+    setup.isPoint = v0 == v1;
+    setup.frontFacing = frontFacing;
+    setup.drawIdx = (uint32_t)batchDrawCnt_;
+
+    // conservative bounds, wide lines and points reach half the width around the end points
+    float extent = setup.width / 2.f + 1.f;
+    const BoundingBox &rect = rasterBounds_;
+    glm::aligned_vec4 &p0 = setup.vertPos[0];
+    glm::aligned_vec4 &p1 = setup.vertPos[1];
+    setup.bounds.min = glm::vec3(std::max(std::min(p0.x, p1.x) - extent, rect.min.x),
+                                 std::max(std::min(p0.y, p1.y) - extent, rect.min.y), 0.f);
+    setup.bounds.max = glm::vec3(std::min(std::max(p0.x, p1.x) + extent, rect.max.x),
+                                 std::min(std::max(p0.y, p1.y) + extent, rect.max.y), 0.f);
+
+    primitiveBinning(setup.bounds, (lines_.size() - 1) << 1 | 1);
+}
 
-    int y = y0;
+void RendererSoft::primitiveBinning(const BoundingBox &bounds, std::size_t binEntry)
+{
+    if (bounds.max.x < bounds.min.x || bounds.max.y < bounds.min.y)
+    {
+        return;
+    }
 
-    auto varyings = MemoryUtils::makeBuffer<float>(varyingsCnt_);
-    VertexHolder pt{};
-    pt.varyings = varyings.get();
+    int tileMinX = (int)bounds.min.x / rasterTileSize_;
+    int tileMinY = (int)bounds.min.y / rasterTileSize_;
+    int tileMaxX = std::min((int)bounds.max.x / rasterTileSize_, tileCntX_ - 1);
+    int tileMaxY = std::min((int)bounds.max.y / rasterTileSize_, tileCntY_ - 1);
 
-    float t = 0;
-    for (int x = x0; x <= x1; x++)
+    for (int tileY = tileMinY; tileY <= tileMaxY; tileY++)
     {
-        t = (float)(x - x0) / (float)dx;
-        pt.fragPos = glm::vec4(x, y, glm::mix(z0, z1, t), glm::mix(w0, w1, t));
-        if (steep)
+        for (int tileX = tileMinX; tileX <= tileMaxX; tileX++)
         {
-            std::swap(pt.fragPos.x, pt.fragPos.y);
+            tileBins_[tileY * tileCntX_ + tileX].push_back(binEntry);
         }
-        interpolateLinear(pt.varyings, varyingsIn, varyingsCnt_, t);
-        rasterizationPoint(&pt, lineWidth);
+    }
+}
+
+// whether (x, y) is inside the diamond |dx| + |dy| < 1/2 around the center of pixel (px, py)
+static inline bool insideDiamond(int px, int py, float x, float y)
+{
+    return std::abs(x - ((float)px + 0.5f)) + std::abs(y - ((float)py + 0.5f)) < 0.5f;
+}
 
-        error += dError;
-        if (error > dx)
+void RendererSoft::rasterizationPoint(LineSetup &point, DrawContext &draw, PixelQuadContext &ctx,
+                                      int tileX, int tileY)
+{
+    // square of point size centered at the point, covers the samples inside
+    glm::aligned_vec4 &pos = point.vertPos[0];
+    float halfSize = point.width / 2.f;
+    float left = pos.x - halfSize;
+    float right = pos.x + halfSize;
+    float bottom = pos.y - halfSize;
+    float top = pos.y + halfSize;
+
+    // pixels inside both the square and the tile
+    int startX =
+        std::max({tileX * rasterTileSize_, (int)point.bounds.min.x, (int)std::floor(left)});
+    int startY =
+        std::max({tileY * rasterTileSize_, (int)point.bounds.min.y, (int)std::floor(bottom)});
+    int endX = std::min({(tileX + 1) * rasterTileSize_, (int)point.bounds.max.x + 1,
+                         (int)std::floor(right) + 1});
+    int endY = std::min({(tileY + 1) * rasterTileSize_, (int)point.bounds.max.y + 1,
+                         (int)std::floor(top) + 1});
+
+    const glm::vec2 *locations = rasterSampleLocations(rasterSamples_);
+    for (int y = startY; y < endY; y++)
+    {
+        for (int x = startX; x < endX; x++)
         {
-            y += (y1 > y0 ? 1 : -1);
-            error -= 2 * dx;
+            uint32_t sampleMask = 0;
+            for (int idx = 0; idx < rasterSamples_; idx++)
+            {
+                float sx = (float)x + locations[idx].x;
+                float sy = (float)y + locations[idx].y;
+                if (sx >= left && sx < right && sy >= bottom && sy < top)
+                {
+                    sampleMask |= 1u << idx;
+                }
+            }
+            if (sampleMask)
+            {
+                rasterizationLineFragment(point, draw, ctx, x, y, 0.f, sampleMask);
+            }
         }
     }
 }
 
-void RendererSoft::rasterizationTriangle(VertexHolder *v0, VertexHolder *v1, VertexHolder *v2,
-                                         bool frontFacing)
+void RendererSoft::rasterizationLine(LineSetup &line, DrawContext &draw, PixelQuadContext &ctx,
+                                     int tileX, int tileY)
 {
-    // TODO top-left rule
-    VertexHolder *vert[3] = {v0, v1, v2};
-    glm::aligned_vec4 screenPos[3] = {vert[0]->fragPos, vert[1]->fragPos, vert[2]->fragPos};
-    BoundingBox bounds = triangleBoundingBox(screenPos, viewport_.width, viewport_.height);
-    bounds.min -= 1.f;
+    // pixels inside both the line bounds and the tile
+    int startX = std::max(tileX * rasterTileSize_, (int)line.bounds.min.x);
+    int startY = std::max(tileY * rasterTileSize_, (int)line.bounds.min.y);
+    int endX = std::min((tileX + 1) * rasterTileSize_, (int)line.bounds.max.x + 1);
+    int endY = std::min((tileY + 1) * rasterTileSize_, (int)line.bounds.max.y + 1);
+
+    // step along the major axis a, the minor axis b changes by at most one per step
+    glm::aligned_vec4 &p0 = line.vertPos[0];
+    glm::aligned_vec4 &p1 = line.vertPos[1];
+    bool xMajor = std::abs(p1.x - p0.x) >= std::abs(p1.y - p0.y);
+    float a0 = xMajor ? p0.x : p0.y;
+    float b0 = xMajor ? p0.y : p0.x;
+    float a1 = xMajor ? p1.x : p1.y;
+    float b1 = xMajor ? p1.y : p1.x;
+    int tileStartA = xMajor ? startX : startY;
+    int tileEndA = xMajor ? endX : endY;
+    int tileStartB = xMajor ? startY : startX;
+    int tileEndB = xMajor ? endY : endX;
+
+    float da = a1 - a0;
+    if (da == 0.f)
+    {
+        return;
+    }
+    float slope = (b1 - b0) / da;
 
-    auto blockSize = rasterBlockSize_;
-    int blockCntX = (bounds.max.x - bounds.min.x + blockSize - 1.f) / blockSize;
-    int blockCntY = (bounds.max.y - bounds.min.y + blockSize - 1.f) / blockSize;
+    // multisample lines are rectangles of line width, non-multisample lines follow the
+    // diamond-exit rule and are widened along the minor axis
+    bool multiSample = rasterSamples_ > 1;
+    float halfWidth = line.width / 2.f;
+    float lineLength = std::sqrt(da * da + (b1 - b0) * (b1 - b0));
+    float extentA = multiSample ? halfWidth * std::abs(b1 - b0) / lineLength : 0.f;
+    float extentB = multiSample ? halfWidth * lineLength / std::abs(da) : line.width;
+
+    // major axis range of the line, narrowed to where it passes the tile
+    float minA = std::min(a0, a1) - extentA;
+    float maxA = std::max(a0, a1) + extentA;
+    if (slope != 0.f)
+    {
+        float rangeA0 = a0 + ((float)tileStartB - extentB - 1.f - b0) / slope;
+        float rangeA1 = a0 + ((float)tileEndB + extentB + 1.f - b0) / slope;
+        minA = std::max(minA, std::min(rangeA0, rangeA1));
+        maxA = std::min(maxA, std::max(rangeA0, rangeA1));
+    }
+    else if (b0 < (float)tileStartB - extentB - 1.f || b0 > (float)tileEndB + extentB + 1.f)
+    {
+        return;
+    }
+    int startA = std::max((int)std::floor(minA), tileStartA);
+    int endA = std::min((int)std::floor(maxA) + 1, tileEndA);
 
-    for (int blockY = 0; blockY < blockCntY; blockY++)
+    if (multiSample)
     {
-        for (int blockX = 0; blockX < blockCntX; blockX++)
+        // samples inside the rectangle, by projection onto the line direction and its normal
+        glm::vec2 dir = glm::vec2(p1.x - p0.x, p1.y - p0.y) / lineLength;
+        const glm::vec2 *locations = rasterSampleLocations(rasterSamples_);
+        for (int a = startA; a < endA; a++)
         {
-#ifdef RASTER_MULTI_THREAD
-            threadPool_.pushTask(
-                [&, vert, bounds, blockSize, blockX, blockY](int thread_id)
+            float bLeft = b0 + slope * ((float)a - a0);
+            float bRight = b0 + slope * ((float)a + 1.f - a0);
+            int startB = std::max((int)std::floor(std::min(bLeft, bRight) - extentB), tileStartB);
+            int endB = std::min((int)std::floor(std::max(bLeft, bRight) + extentB) + 1, tileEndB);
+            for (int b = startB; b < endB; b++)
+            {
+                int x = xMajor ? a : b;
+                int y = xMajor ? b : a;
+                uint32_t sampleMask = 0;
+                for (int idx = 0; idx < rasterSamples_; idx++)
                 {
-                    // init pixel quad
-                    auto pixelQuad = threadQuadCtx_[thread_id];
-#else
-            auto pixelQuad = threadQuadCtx_[0];
-#endif
-                    pixelQuad.frontFacing = frontFacing;
-
-                    for (int i = 0; i < 3; i++)
+                    glm::vec2 d((float)x + locations[idx].x - p0.x,
+                                (float)y + locations[idx].y - p0.y);
+                    float along = glm::dot(d, dir);
+                    float across = d.x * dir.y - d.y * dir.x;
+                    if (along >= 0.f && along < lineLength && std::abs(across) < halfWidth)
                     {
-                        pixelQuad.vertPos[i] = vert[i]->fragPos;
-                        pixelQuad.vertZ[i] = &vert[i]->fragPos.z;
-                        pixelQuad.vertW[i] = vert[i]->fragPos.w;
-                        pixelQuad.vertVaryings[i] = vert[i]->varyings;
+                        sampleMask |= 1u << idx;
                     }
+                }
+                if (sampleMask)
+                {
+                    glm::vec2 center((float)x + 0.5f - p0.x, (float)y + 0.5f - p0.y);
+                    float t = glm::clamp(glm::dot(center, dir) / lineLength, 0.f, 1.f);
+                    rasterizationLineFragment(line, draw, ctx, x, y, t, sampleMask);
+                }
+            }
+        }
+        return;
+    }
 
-                    glm::aligned_vec4 *vertPos = pixelQuad.vertPos;
-                    pixelQuad.vertPosFlat[0] = {vertPos[2].x, vertPos[1].x, vertPos[0].x, 0.f};
-                    pixelQuad.vertPosFlat[1] = {vertPos[2].y, vertPos[1].y, vertPos[0].y, 0.f};
-                    pixelQuad.vertPosFlat[2] = {vertPos[0].z, vertPos[1].z, vertPos[2].z, 0.f};
-                    pixelQuad.vertPosFlat[3] = {vertPos[0].w, vertPos[1].w, vertPos[2].w, 0.f};
-
-                    // block rasterization
-                    int blockStartX = bounds.min.x + blockX * blockSize;
-                    int blockStartY = bounds.min.y + blockY * blockSize;
-                    for (int y = blockStartY + 1; y < blockStartY + blockSize && y <= bounds.max.y;
-                         y += 2)
-                    {
-                        for (int x = blockStartX + 1;
-                             x < blockStartX + blockSize && x <= bounds.max.x; x += 2)
-                        {
-                            pixelQuad.Init((float)x, (float)y, rasterSamples_);
-                            rasterizationPixelQuad(pixelQuad);
-                        }
-                    }
-#ifdef RASTER_MULTI_THREAD
-                });
-#endif
+    // diamond-exit rule: a pixel is drawn when the line exits its diamond, a line with slope
+    // below one enters the diamond of each pixel it exits through the minor axis diagonal
+    int widthPixels = std::max((int)std::lround(line.width), 1);
+    int offsetB = (widthPixels - 1) / 2;
+    int firstA = (int)std::floor(a0);
+    for (int a = startA; a < endA; a++)
+    {
+        float t = ((float)a + 0.5f - a0) / da;
+        int b;
+        if (t >= 0.f && t <= 1.f)
+        {
+            b = (int)std::floor(b0 + slope * ((float)a + 0.5f - a0));
+        }
+        else
+        {
+            // starting past the diagonal, the first pixel is drawn only if the line starts
+            // inside its diamond
+            b = (int)std::floor(b0);
+            if (a != firstA || !insideDiamond(a, b, a0, b0))
+            {
+                continue;
+            }
+            t = 0.f;
+        }
+
+        // the line ending inside the diamond never exits it
+        if (insideDiamond(a, b, a1, b1))
+        {
+            continue;
+        }
+
+        for (int i = 0; i < widthPixels; i++)
+        {
+            int bi = b - offsetB + i;
+            if (bi < tileStartB || bi >= tileEndB)
+            {
+                continue;
+            }
+            rasterizationLineFragment(line, draw, ctx, xMajor ? a : bi, xMajor ? bi : a, t, 1u);
         }
     }
 }
 
-void RendererSoft::rasterizationPixelQuad(PixelQuadContext &quad)
+void RendererSoft::rasterizationLineFragment(LineSetup &line, DrawContext &draw,
+                                             PixelQuadContext &ctx, int x, int y, float t,
+                                             uint32_t sampleMask)
 {
-    glm::aligned_vec4 *vert = quad.vertPosFlat;
-    glm::aligned_vec4 &v0 = quad.vertPos[0];
+    glm::vec4 screenPos((float)x + 0.5f, (float)y + 0.5f,
+                        glm::mix(line.vertPos[0].z, line.vertPos[1].z, t),
+                        glm::mix(line.vertPos[0].w, line.vertPos[1].w, t));
 
-    // barycentric
-    for (auto &pixel : quad.pixels)
+    // per thread varyings storage, derivatives all read this pixel
+    float *varyings = ctx.pixels[0].varyingsFrag;
+    if (draw.varyingsHalf)
     {
-        for (auto &sample : pixel.samples)
+        const uint16_t *varsIn[2] = {(const uint16_t *)line.vertVaryings[0],
+                                     (const uint16_t *)line.vertVaryings[1]};
+        interpolateLinearHalf(varyings, varsIn, draw.varyingsCnt, t);
+    }
+    else
+    {
+        const float *varsIn[2] = {(const float *)line.vertVaryings[0],
+                                  (const float *)line.vertVaryings[1]};
+        interpolateLinear(varyings, varsIn, draw.varyingsCnt, t);
+    }
+
+    ShaderProgramSoft *shader = ctx.shaderProgram.get();
+    processFragmentShader(screenPos, line.frontFacing, varyings, shader);
+    auto &builtIn = shader->getShaderBuiltin();
+    if (builtIn.discard)
+    {
+        return;
+    }
+
+    for (int idx = 0; idx < rasterSamples_; idx++)
+    {
+        if (sampleMask & (1u << idx))
         {
-            sample.inside = barycentric(vert, v0, sample.position, sample.barycentric);
+            processPerSampleOperations(x, y, screenPos.z, builtIn.FragColor, idx, draw);
+        }
+    }
+}
+
+void RendererSoft::rasterizationTile(int tileX, int tileY, std::size_t threadId)
+{
+    uint32_t hiZDrawIdx = UINT32_MAX;
+    bool clearResolved = false;
+
+    // first primitive touching the tile, fill lazy clears
+    auto beginTileWrite = [&]()
+    {
+        if (clearResolved)
+        {
+            return;
+        }
+        if (fboColor_)
+        {
+            fboColor_->beginTileWrite(tileX, tileY);
+        }
+        if (fboDepth_)
+        {
+            fboDepth_->beginTileWrite(tileX, tileY);
+        }
+        clearResolved = true;
+    };
+
+    for (std::size_t binEntry : tileBins_[tileY * tileCntX_ + tileX])
+    {
+        if (binEntry & 1)
+        {
+            LineSetup &line = lines_[binEntry >> 1];
+            DrawContext &draw = *drawContexts_[line.drawIdx];
+            beginTileWrite();
+            if (line.isPoint)
+            {
+                rasterizationPoint(line, draw, draw.threadQuadCtx[threadId], tileX, tileY);
+            }
+            else
+            {
+                rasterizationLine(line, draw, draw.threadQuadCtx[threadId], tileX, tileY);
+            }
+            continue;
+        }
+
+        std::size_t triangleIdx = binEntry >> 1;
+        uint32_t drawIdx = triangles_.drawIdx[triangleIdx];
+        DrawContext &draw = *drawContexts_[drawIdx];
+
+        // reject triangles occluded in the whole tile
+        if (draw.hiZEnabled)
+        {
+            HiZTile &hiZ = hiZTiles_[tileY * hiZTileCntX_ + tileX];
+            // tighten bounds once per draw, depth writes in between only expand them
+            if (hiZDrawIdx != drawIdx && hiZ.dirty)
+            {
+                hiZUpdateTile(hiZ, tileX, tileY);
+            }
+            hiZDrawIdx = drawIdx;
+            if (!hiZTest(triangles_.minZ[triangleIdx], triangles_.maxZ[triangleIdx], hiZ,
+                         draw.renderState->depthFunc))
+            {
+                continue;
+            }
+        }
+
+        beginTileWrite();
+        TriangleSetup &triangle = triangles_.setups[triangleIdx];
+        if (triangle.micro)
+        {
+            rasterizationTriangleMicro(triangle, draw, draw.threadQuadCtx[threadId]);
+        }
+        else
+        {
+            rasterizationTriangle(triangle, draw, draw.threadQuadCtx[threadId], tileX, tileY);
+        }
+    }
+}
+
+void RendererSoft::rasterizationTriangle(TriangleSetup &triangle, DrawContext &draw,
+                                         PixelQuadContext &quad, int tileX, int tileY)
+{
+    BoundingBox &bounds = triangle.bounds;
+    RasterLaneLayout &layout = rasterLanes_;
+
+    // triangle bounds inside tile, quads aligned to even pixel coordinates
+    int tileStartX = tileX * rasterTileSize_;
+    int tileStartY = tileY * rasterTileSize_;
+    int boundsX = (int)bounds.min.x;
+    int boundsY = (int)bounds.min.y;
+    int startX = std::max(tileStartX, boundsX & ~1);
+    int startY = std::max(tileStartY, boundsY & ~1);
+    int endX = std::min(tileStartX + rasterTileSize_ - 1, (int)bounds.max.x);
+    int endY = std::min(tileStartY + rasterTileSize_ - 1, (int)bounds.max.y);
+
+    // edge value and barycentric offsets of each sample lane relative to the step origin
+    alignas(32) int32_t laneEdge[3][RASTER_LANE_MAX];
+    alignas(32) float laneBary[3][RASTER_LANE_MAX];
+    const float subPixel = 1.f / (1 << RASTER_SUBPIXEL_BITS);
+    for (int i = 0; i < 3; i++)
+    {
+        for (int l = 0; l < layout.laneCnt; l++)
+        {
+            laneEdge[i][l] =
+                (int32_t)(triangle.edgeA[i] * layout.dx[l] + triangle.edgeB[i] * layout.dy[l]);
+            laneBary[i][l] = (triangle.baryDx[i] * (float)layout.dx[l] +
+                              triangle.baryDy[i] * (float)layout.dy[l]) * subPixel;
         }
-        pixel.InitCoverage();
-        pixel.InitShadingSample();
     }
-    if (!quad.CheckInside())
+
+    // block classification by edge values at block corners
+    int stepPixels = layout.quadCnt * 2;
+    int64_t blockSize = (int64_t)rasterBlockSize_ << RASTER_SUBPIXEL_BITS;
+    int64_t edgeStepX[3], edgeStepY[3], blockMin[3], blockMax[3];
+    for (int i = 0; i < 3; i++)
     {
-        return;
+        edgeStepX[i] = triangle.edgeA[i] * ((int64_t)stepPixels << RASTER_SUBPIXEL_BITS);
+        edgeStepY[i] = triangle.edgeB[i] * ((int64_t)2 << RASTER_SUBPIXEL_BITS);
+
+        // edge value range over the block relative to its min corner, including top-left bias
+        int64_t dx = triangle.edgeA[i] * blockSize;
+        int64_t dy = triangle.edgeB[i] * blockSize;
+        blockMin[i] = std::min<int64_t>(dx, 0) + std::min<int64_t>(dy, 0) + triangle.edgeBias[i];
+        blockMax[i] = std::max<int64_t>(dx, 0) + std::max<int64_t>(dy, 0) + triangle.edgeBias[i];
     }
 
-    for (auto &pixel : quad.pixels)
+    alignas(32) float bc[3][RASTER_LANE_MAX];
+    int blockStartX = startX - (startX - tileStartX) % rasterBlockSize_;
+    int blockStartY = startY - (startY - tileStartY) % rasterBlockSize_;
+    for (int blockY = blockStartY; blockY <= endY; blockY += rasterBlockSize_)
     {
-        for (auto &sample : pixel.samples)
+        for (int blockX = blockStartX; blockX <= endX; blockX += rasterBlockSize_)
         {
-            if (!sample.inside)
+            bool fullyCovered = true;
+            bool fullyOutside = false;
+            int64_t edgeCorner[3];
+            for (int i = 0; i < 3; i++)
+            {
+                edgeCorner[i] = triangle.edgeA[i] * ((int64_t)blockX << RASTER_SUBPIXEL_BITS) +
+                                triangle.edgeB[i] * ((int64_t)blockY << RASTER_SUBPIXEL_BITS) +
+                                triangle.edgeC[i];
+                fullyOutside |= (edgeCorner[i] + blockMax[i] <= 0);
+                fullyCovered &= (edgeCorner[i] + blockMin[i] > 0);
+            }
+            if (fullyOutside)
             {
                 continue;
             }
 
-            // interpolate z, w
-            interpolateBarycentric(&sample.position.z, quad.vertZ, 2, sample.barycentric);
+            // quads of block inside triangle bounds
+            int x0 = std::max(blockX, startX);
+            int y0 = std::max(blockY, startY);
+            int x1 = std::min(blockX + rasterBlockSize_ - 1, endX);
+            int y1 = std::min(blockY + rasterBlockSize_ - 1, endY);
+
+            // edge values at the step origin, stepped incrementally
+            int64_t edgeRow[3];
+            for (int i = 0; i < 3; i++)
+            {
+                edgeRow[i] = edgeCorner[i] +
+                             triangle.edgeA[i] * ((int64_t)(x0 - blockX) << RASTER_SUBPIXEL_BITS) +
+                             triangle.edgeB[i] * ((int64_t)(y0 - blockY) << RASTER_SUBPIXEL_BITS);
+            }
+
+            for (int y = y0; y <= y1; y += 2)
+            {
+                int64_t edge[3] = {edgeRow[0], edgeRow[1], edgeRow[2]};
+                for (int x = x0; x <= x1; x += stepPixels)
+                {
+                    // barycentric at the step origin
+                    float bary[3];
+                    for (int i = 0; i < 3; i++)
+                    {
+                        glm::aligned_vec4 &v = triangle.vertPos[(i + 1) % 3];
+                        bary[i] = triangle.baryDx[i] * ((float)x - v.x) +
+                                  triangle.baryDy[i] * ((float)y - v.y);
+                    }
+
+                    uint32_t mask = rasterizationEdges(triangle, edge, bary, laneEdge, laneBary,
+                                                       bc, fullyCovered);
+
+                    // quads reaching past the clamped bounds, guard band triangles extend
+                    // beyond the viewport and must not write the pixels outside it
+                    if (x < boundsX || x + stepPixels - 1 > endX || y < boundsY || y + 1 > endY)
+                    {
+                        mask &= layout.PixelRectMask(boundsX - x, endX - x, boundsY - y, endY - y);
+                    }
+                    if (draw.depthStepKernel)
+                    {
+                        if (mask)
+                        {
+                            draw.depthStepKernel(*this, triangle, draw, x, y, x1, mask, bc);
+                        }
+                    }
+                    else
+                    {
+                        for (int q = 0; q < layout.quadCnt; q++)
+                        {
+                            int quadX = x + q * 2;
+                            if (quadX > x1)
+                            {
+                                break;
+                            }
+                            if (!(mask & layout.coverageMask[q]))
+                            {
+                                continue;
+                            }
+                            rasterizationQuadSetup(quad, quadX, y, q, mask, bc);
+                            draw.pixelQuadKernel(*this, quad, triangle, draw);
+                        }
+                    }
+
+                    for (int i = 0; i < 3; i++)
+                    {
+                        edge[i] += edgeStepX[i];
+                    }
+                }
+
+                for (int i = 0; i < 3; i++)
+                {
+                    edgeRow[i] += edgeStepY[i];
+                }
+            }
+        }
+    }
+}
+
+void RendererSoft::rasterizationTriangleMicro(TriangleSetup &triangle, DrawContext &draw,
+                                              PixelQuadContext &quad)
+{
+    BoundingBox &bounds = triangle.bounds;
+    RasterLaneLayout &layout = rasterLanes_;
+    const float subPixel = 1.f / (1 << RASTER_SUBPIXEL_BITS);
+
+    // one step per quad row, sample lanes evaluated directly without block setup
+    int boundsX = (int)bounds.min.x;
+    int boundsY = (int)bounds.min.y;
+    int x = boundsX & ~1;
+    int x1 = (int)bounds.max.x;
+    int y1 = (int)bounds.max.y;
+
+    // lanes left unset are masked out, zeroed once for the full width depth step
+    alignas(32) float bc[3][RASTER_LANE_MAX] = {};
+    for (int y = boundsY & ~1; y <= y1; y += 2)
+    {
+        int64_t edge[3];
+        float bary[3];
+        for (int i = 0; i < 3; i++)
+        {
+            edge[i] = triangle.edgeA[i] * ((int64_t)x << RASTER_SUBPIXEL_BITS) +
+                      triangle.edgeB[i] * ((int64_t)y << RASTER_SUBPIXEL_BITS) +
+                      triangle.edgeC[i] + triangle.edgeBias[i];
+
+            glm::aligned_vec4 &v = triangle.vertPos[(i + 1) % 3];
+            bary[i] = triangle.baryDx[i] * ((float)x - v.x) + triangle.baryDy[i] * ((float)y - v.y);
+        }
+
+        uint32_t mask = 0;
+        for (int l = 0; l < layout.laneCnt; l++)
+        {
+            bool inside = true;
+            for (int i = 0; i < 3; i++)
+            {
+                inside &= edge[i] + triangle.edgeA[i] * layout.dx[l] +
+                              triangle.edgeB[i] * layout.dy[l] > 0;
+            }
+            mask |= (uint32_t)inside << l;
+        }
+        mask &= layout.PixelRectMask(boundsX - x, x1 - x, boundsY - y, y1 - y);
+        if (!mask)
+        {
+            continue;
+        }
+
+        // depth only reads the covered lanes
+        if (draw.depthStepKernel)
+        {
+            for (uint32_t bits = mask; bits; bits &= bits - 1)
+            {
+                int l = std::countr_zero(bits);
+                for (int i = 0; i < 3; i++)
+                {
+                    bc[i][l] = bary[i] + (triangle.baryDx[i] * (float)layout.dx[l] +
+                                          triangle.baryDy[i] * (float)layout.dy[l]) * subPixel;
+                }
+            }
+            draw.depthStepKernel(*this, triangle, draw, x, y, x1, mask, bc);
+            continue;
+        }
+        for (int q = 0; q < layout.quadCnt; q++)
+        {
+            int quadX = x + q * 2;
+            if (quadX > x1)
+            {
+                break;
+            }
+            if (!(mask & layout.coverageMask[q]))
+            {
+                continue;
+            }
+            rasterizationQuadMicro(quad, triangle, x, y, q, mask, bary);
+            draw.pixelQuadKernel(*this, quad, triangle, draw);
+        }
+    }
+}
+
+void RendererSoft::rasterizationQuadMicro(PixelQuadContext &quad, TriangleSetup &triangle, int x,
+                                          int y, int q, uint32_t mask, const float bary[3])
+{
+    RasterLaneLayout &layout = rasterLanes_;
+    const float subPixel = 1.f / (1 << RASTER_SUBPIXEL_BITS);
+    quad.MoveTo((float)(x + q * 2), (float)y);
+    for (int p = 0; p < 4; p++)
+    {
+        auto &pixel = quad.pixels[p];
+        int center = (int)pixel.samples.size() - 1;
+        for (int s = 0; s <= center; s++)
+        {
+            // barycentric of uncovered samples is never read, except the pixel center which
+            // shades uncovered quad pixels for derivatives
+            int l = layout.lane[q][p][s];
+            SampleContext &sample = pixel.samples[s];
+            sample.inside = (mask >> l) & 1u;
+            if (!sample.inside && s != center)
+            {
+                continue;
+            }
+            for (int i = 0; i < 3; i++)
+            {
+                sample.barycentric[i] = bary[i] + (triangle.baryDx[i] * (float)layout.dx[l] +
+                                                   triangle.baryDy[i] * (float)layout.dy[l]) *
+                                                      subPixel;
+            }
+            sample.barycentric[3] = 0.f;
+        }
+        pixel.InitCoverage();
+        pixel.InitShadingSample();
+    }
+}
+
+void RendererSoft::rasterizationQuadSetup(PixelQuadContext &quad, int x, int y, int q,
+                                          uint32_t mask, float bc[3][RASTER_LANE_MAX])
+{
+    RasterLaneLayout &layout = rasterLanes_;
+    quad.MoveTo((float)x, (float)y);
+    for (int p = 0; p < 4; p++)
+    {
+        auto &pixel = quad.pixels[p];
+        for (int s = 0; s < pixel.samples.size(); s++)
+        {
+            int l = layout.lane[q][p][s];
+            pixel.samples[s].inside = (mask >> l) & 1u;
+            pixel.samples[s].barycentric = {bc[0][l], bc[1][l], bc[2][l], 0.f};
+        }
+        pixel.InitCoverage();
+        pixel.InitShadingSample();
+    }
+}
+
+uint32_t RendererSoft::rasterizationEdges(TriangleSetup &triangle, const int64_t edge[3],
+                                          const float bary[3],
+                                          const int32_t laneEdge[3][RASTER_LANE_MAX],
+                                          const float laneBary[3][RASTER_LANE_MAX],
+                                          float bc[3][RASTER_LANE_MAX], bool fullyCovered)
+{
+    uint32_t mask = 0;
+    int laneCnt = rasterLanes_.laneCnt;
+
+    // inside block fully covered, barycentric only
+    if (fullyCovered)
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            for (int l = 0; l < laneCnt; l++)
+            {
+                bc[i][l] = bary[i] + laneBary[i][l];
+            }
+        }
+        return (uint32_t)((1ull << laneCnt) - 1);
+    }
+
+#if defined(SOFTGL_SIMD_OPT) && defined(__AVX2__)
+    // step origin edge value saturated to 32 bits, lane offsets never exceed 2^28
+    __m256i edgeBase[3];
+    __m256 baryBase[3];
+    for (int i = 0; i < 3; i++)
+    {
+        int64_t e = std::clamp<int64_t>(edge[i] + triangle.edgeBias[i], -(1 << 30), 1 << 30);
+        edgeBase[i] = _mm256_set1_epi32((int32_t)e);
+        baryBase[i] = _mm256_set1_ps(bary[i]);
+    }
+    __m256i zero = _mm256_setzero_si256();
+
+    // 8 lanes per instruction
+    for (int l = 0; l < laneCnt; l += 8)
+    {
+        __m256i inside = _mm256_set1_epi32(-1);
+        for (int i = 0; i < 3; i++)
+        {
+            __m256i offset = _mm256_load_si256((__m256i *)&laneEdge[i][l]);
+            __m256i e = _mm256_add_epi32(edgeBase[i], offset);
+            inside = _mm256_and_si256(inside, _mm256_cmpgt_epi32(e, zero));
+
+            __m256 b = _mm256_add_ps(baryBase[i], _mm256_load_ps(&laneBary[i][l]));
+            _mm256_store_ps(&bc[i][l], b);
+        }
+        mask |= (uint32_t)_mm256_movemask_ps(_mm256_castsi256_ps(inside)) << l;
+    }
+#else
+    for (int l = 0; l < laneCnt; l++)
+    {
+        bool inside = true;
+        for (int i = 0; i < 3; i++)
+        {
+            inside &= (edge[i] + triangle.edgeBias[i] + laneEdge[i][l]) > 0;
+            bc[i][l] = bary[i] + laneBary[i][l];
+        }
+        mask |= (uint32_t)inside << l;
+    }
+#endif
+
+    return mask;
+}
+
+template <std::size_t... Keys>
+constexpr std::array<PixelQuadKernel, sizeof...(Keys)>
+RendererSoft::makePixelQuadKernels(std::index_sequence<Keys...>)
+{
+    return {&RendererSoft::pixelQuadKernel<RasterKernelSpec::fromKey(Keys)>...};
+}
+
+template <RasterKernelSpec Spec>
+void RendererSoft::pixelQuadKernel(RendererSoft &renderer, PixelQuadContext &quad,
+                                   TriangleSetup &triangle, DrawContext &draw)
+{
+    renderer.rasterizationPixelQuad<Spec>(quad, triangle, draw);
+}
+
+PixelQuadKernel RendererSoft::getPixelQuadKernel(const RasterKernelSpec &spec)
+{
+    static constexpr auto kernels =
+        makePixelQuadKernels(std::make_index_sequence<RasterKernelSpec::kKeyCnt>());
+    return kernels[spec.key()];
+}
+
+template <std::size_t... Keys>
+constexpr std::array<DepthStepKernel, sizeof...(Keys)>
+RendererSoft::makeDepthStepKernels(std::index_sequence<Keys...>)
+{
+    return {&RendererSoft::depthStepKernel<RasterKernelSpec::fromDepthKey(Keys)>...};
+}
+
+template <RasterKernelSpec Spec>
+void RendererSoft::depthStepKernel(RendererSoft &renderer, TriangleSetup &triangle,
+                                   DrawContext &draw, int x, int y, int x1, uint32_t mask,
+                                   const float bc[3][RASTER_LANE_MAX])
+{
+    renderer.rasterizationDepthStep<Spec>(triangle, draw, x, y, x1, mask, bc);
+}
+
+DepthStepKernel RendererSoft::getDepthStepKernel(const RasterKernelSpec &spec)
+{
+    static constexpr auto kernels =
+        makeDepthStepKernels(std::make_index_sequence<RasterKernelSpec::kDepthKeyCnt>());
+    return kernels[spec.depthKey()];
+}
+
+template <RasterKernelSpec Spec>
+void RendererSoft::rasterizationDepthStep(TriangleSetup &triangle, DrawContext &draw, int x,
+                                          int y, int x1, uint32_t mask,
+                                          const float bc[3][RASTER_LANE_MAX])
+{
+    // nothing is written without depth test
+    if constexpr (Spec.depthMode != RasterDepth_NONE)
+    {
+        RasterLaneLayout &layout = rasterLanes_;
+        float z0 = triangle.vertZ[0];
+        float z1 = triangle.vertZ[1];
+        float z2 = triangle.vertZ[2];
+        float minDepth = draw.viewport.absMinDepth;
+        float maxDepth = draw.viewport.absMaxDepth;
+
+#if defined(SOFTGL_SIMD_OPT) && defined(__AVX2__)
+        // both quads of the step inside the frame: 8 lanes are 2 rows of 4 linear depth values
+        if constexpr (!Spec.multiSample && Spec.depthMode != RasterDepth_GENERIC)
+        {
+            if (x + 2 <= x1 && x + 3 < fboDepth_->width && y + 1 < fboDepth_->height)
+            {
+                __m256 z = _mm256_add_ps(
+                    _mm256_add_ps(_mm256_mul_ps(_mm256_load_ps(bc[0]), _mm256_set1_ps(z0)),
+                                  _mm256_mul_ps(_mm256_load_ps(bc[1]), _mm256_set1_ps(z1))),
+                    _mm256_mul_ps(_mm256_load_ps(bc[2]), _mm256_set1_ps(z2)));
+
+                // depth clamping, coverage
+                z = _mm256_min_ps(_mm256_max_ps(z, _mm256_set1_ps(minDepth)),
+                                  _mm256_set1_ps(maxDepth));
+                __m256i laneBits = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+                __m256i covered = _mm256_and_si256(_mm256_set1_epi32((int32_t)mask), laneBits);
+                __m256 pass = _mm256_castsi256_ps(_mm256_cmpeq_epi32(covered, laneBits));
+
+                // lanes are quad pixels (x, y) (x + 1, y) (x, y + 1) (x + 1, y + 1), then x + 2
+                float *row0 = fboDepth_->buffer->get(x, y);
+                float *row1 = fboDepth_->buffer->get(x, y + 1);
+                __m128d d0 = _mm_castps_pd(_mm_loadu_ps(row0));
+                __m128d d1 = _mm_castps_pd(_mm_loadu_ps(row1));
+                __m256 dst = _mm256_set_m128(_mm_castpd_ps(_mm_unpackhi_pd(d0, d1)),
+                                             _mm_castpd_ps(_mm_unpacklo_pd(d0, d1)));
+
+                if constexpr (Spec.depthMode == RasterDepth_LESS)
+                {
+                    pass = _mm256_and_ps(pass, _mm256_cmp_ps(z, dst, _CMP_LT_OQ));
+                }
+                else if constexpr (Spec.depthMode == RasterDepth_LEQUAL)
+                {
+                    pass = _mm256_and_ps(pass, _mm256_cmp_ps(z, dst, _CMP_LE_OQ));
+                }
+                else if constexpr (Spec.depthMode == RasterDepth_GREATER)
+                {
+                    pass = _mm256_and_ps(pass, _mm256_cmp_ps(z, dst, _CMP_GT_OQ));
+                }
+                else
+                {
+                    pass = _mm256_and_ps(pass, _mm256_cmp_ps(z, dst, _CMP_GE_OQ));
+                }
+
+                if constexpr (Spec.depthWrite)
+                {
+                    int passMask = _mm256_movemask_ps(pass);
+                    if (passMask)
+                    {
+                        __m256 out = _mm256_blendv_ps(dst, z, pass);
+                        __m128d lo = _mm_castps_pd(_mm256_castps256_ps128(out));
+                        __m128d hi = _mm_castps_pd(_mm256_extractf128_ps(out, 1));
+                        _mm_storeu_ps(row0, _mm_castpd_ps(_mm_unpacklo_pd(lo, hi)));
+                        _mm_storeu_ps(row1, _mm_castpd_ps(_mm_unpackhi_pd(lo, hi)));
+
+                        // all lanes are in one tile, expand its bounds by the written range
+                        alignas(32) float depth[8];
+                        _mm256_store_ps(depth, z);
+                        float minZ = FLT_MAX;
+                        float maxZ = -FLT_MAX;
+                        for (int l = 0; l < 8; l++)
+                        {
+                            if (passMask & (1 << l))
+                            {
+                                minZ = std::min(minZ, depth[l]);
+                                maxZ = std::max(maxZ, depth[l]);
+                            }
+                        }
+                        hiZWrite(x, y, minZ, maxZ);
+                    }
+                }
+                return;
+            }
+        }
+#endif
+
+        for (int q = 0; q < layout.quadCnt; q++)
+        {
+            int quadX = x + q * 2;
+            if (quadX > x1)
+            {
+                break;
+            }
+            for (int p = 0; p < 4; p++)
+            {
+                for (int s = 0; s < rasterSamples_; s++)
+                {
+                    int l = layout.lane[q][p][s];
+                    if (!((mask >> l) & 1u))
+                    {
+                        continue;
+                    }
+
+                    // depth clipping per sample, single sample pixels are clamped in the depth
+                    // test like the shading sample of the pixel quad path
+                    float z = bc[0][l] * z0 + bc[1][l] * z1 + bc[2][l] * z2;
+                    if (Spec.multiSample && (z < minDepth || z > maxDepth))
+                    {
+                        continue;
+                    }
+                    sampleDepthTest<Spec, Spec.depthWrite>(quadX + (p & 1), y + (p >> 1), z, s,
+                                                           draw);
+                }
+            }
+        }
+    }
+}
+
+template <RasterKernelSpec Spec>
+void RendererSoft::rasterizationPixelQuad(PixelQuadContext &quad, TriangleSetup &triangle,
+                                          DrawContext &draw)
+{
+    for (auto &pixel : quad.pixels)
+    {
+        for (auto &sample : pixel.samples)
+        {
+            if (!sample.inside)
+            {
+                continue;
+            }
+
+            // interpolate z, w
+            sample.position.z = glm::dot(sample.barycentric, triangle.vertZ);
+            sample.position.w = glm::dot(sample.barycentric, triangle.vertW);
+
+            // depth clipping
+            if (sample.position.z < draw.viewport.absMinDepth ||
+                sample.position.z > draw.viewport.absMaxDepth)
+            {
+                sample.inside = false;
+            }
+
+            // barycentric correction
+            sample.barycentric *= (1.f / sample.position.w * triangle.vertW);
+        }
+    }
+
+    // early z
+    if constexpr (Spec.depthMode != RasterDepth_NONE)
+    {
+        if (earlyZ_ && !earlyZTest<Spec>(quad, draw))
+        {
+            return;
+        }
+    }
+
+    // varying interpolate
+    // note: all quad pixels should perform varying interpolate to enable varying partial derivative
+    auto &builtIn = quad.shaderProgram->getShaderBuiltin();
+    if (draw.fragmentQuad)
+    {
+        // the whole quad is shaded in one call, varyings in lanes
+        if (draw.varyingsHalf)
+        {
+            const uint16_t *varsIn[3] = {(const uint16_t *)triangle.vertVaryings[0],
+                                         (const uint16_t *)triangle.vertVaryings[1],
+                                         (const uint16_t *)triangle.vertVaryings[2]};
+            interpolateBarycentricQuad(quad.varyingsQuad, varsIn, draw.varyingsCnt, quad);
+        }
+        else
+        {
+            const float *varsIn[3] = {(const float *)triangle.vertVaryings[0],
+                                      (const float *)triangle.vertVaryings[1],
+                                      (const float *)triangle.vertVaryings[2]};
+            interpolateBarycentricQuad(quad.varyingsQuad, varsIn, draw.varyingsCnt, quad);
+        }
+
+        builtIn.quadMask = 0;
+        for (int p = 0; p < 4; p++)
+        {
+            builtIn.quadMask |= quad.pixels[p].inside ? 1u << p : 0u;
+            builtIn.FragCoordQuad.setLane(p, quad.pixels[p].sampleShading->position);
+        }
+        builtIn.FrontFacing = triangle.frontFacing;
+        quad.shaderProgram->execFragmentShaderQuad(quad.varyingsQuad);
+    }
+    else if (draw.varyingsHalf)
+    {
+        const uint16_t *varsIn[3] = {(const uint16_t *)triangle.vertVaryings[0],
+                                     (const uint16_t *)triangle.vertVaryings[1],
+                                     (const uint16_t *)triangle.vertVaryings[2]};
+        for (auto &pixel : quad.pixels)
+        {
+            interpolateBarycentricHalf(pixel.varyingsFrag, varsIn, draw.varyingsCnt,
+                                       pixel.sampleShading->barycentric);
+        }
+    }
+    else
+    {
+        const float *varsIn[3] = {(const float *)triangle.vertVaryings[0],
+                                  (const float *)triangle.vertVaryings[1],
+                                  (const float *)triangle.vertVaryings[2]};
+        for (auto &pixel : quad.pixels)
+        {
+            interpolateBarycentric(pixel.varyingsFrag, varsIn, draw.varyingsCnt,
+                                   pixel.sampleShading->barycentric);
+        }
+    }
+
+    // pixel shading
+    for (int p = 0; p < 4; p++)
+    {
+        auto &pixel = quad.pixels[p];
+        if (!pixel.inside)
+        {
+            continue;
+        }
+
+        // fragment shader
+        glm::vec4 fragColor;
+        if (draw.fragmentQuad)
+        {
+            fragColor = builtIn.FragColorQuad.lane(p);
+        }
+        else
+        {
+            processFragmentShader(pixel.sampleShading->position, triangle.frontFacing,
+                                  pixel.varyingsFrag, quad.shaderProgram.get());
+            if (builtIn.discard)
+            {
+                continue;
+            }
+            fragColor = builtIn.FragColor;
+        }
+
+        // per-sample operations
+        if constexpr (Spec.multiSample)
+        {
+            uint32_t sampleMask = 0;
+            for (int idx = 0; idx < pixel.sampleCount; idx++)
+            {
+                auto &sample = pixel.samples[idx];
+                if (sample.inside && sampleDepthTest<Spec, Spec.depthWrite>(
+                                         sample.fboCoord.x, sample.fboCoord.y, sample.position.z,
+                                         idx, draw))
+                {
+                    sampleMask |= 1u << idx;
+                }
+            }
+            auto &coord = pixel.samples[0].fboCoord;
+            pixelColorWriteMs<Spec>(coord.x, coord.y, fragColor, sampleMask, draw);
+        }
+        else
+        {
+            auto &sample = *pixel.sampleShading;
+            if (sampleDepthTest<Spec, Spec.depthWrite>(sample.fboCoord.x, sample.fboCoord.y,
+                                                       sample.position.z, 0, draw))
+            {
+                sampleColorWrite<Spec>(sample.fboCoord.x, sample.fboCoord.y, fragColor, draw);
+            }
+        }
+    }
+}
+
+template <RasterKernelSpec Spec>
+bool RendererSoft::earlyZTest(PixelQuadContext &quad, DrawContext &draw)
+{
+    for (auto &pixel : quad.pixels)
+    {
+        if (!pixel.inside)
+        {
+            continue;
+        }
+        if constexpr (Spec.multiSample)
+        {
+            bool inside = false;
+            for (int idx = 0; idx < pixel.sampleCount; idx++)
+            {
+                auto &sample = pixel.samples[idx];
+                if (!sample.inside)
+                {
+                    continue;
+                }
+                sample.inside = sampleDepthTest<Spec, false>(sample.fboCoord.x, sample.fboCoord.y,
+                                                             sample.position.z, idx, draw);
+                if (sample.inside)
+                {
+                    inside = true;
+                }
+            }
+            pixel.inside = inside;
+        }
+        else
+        {
+            auto &sample = *pixel.sampleShading;
+            sample.inside = sampleDepthTest<Spec, false>(sample.fboCoord.x, sample.fboCoord.y,
+                                                         sample.position.z, 0, draw);
+            pixel.inside = sample.inside;
+        }
+    }
+    return quad.CheckInside();
+}
+
+template <RasterKernelSpec Spec, bool DepthWrite>
+bool RendererSoft::sampleDepthTest(int x, int y, float depth, int sample, DrawContext &draw)
+{
+    if constexpr (Spec.depthMode == RasterDepth_NONE)
+    {
+        return true;
+    }
+    else
+    {
+        // depth clamping
+        depth = glm::clamp(depth, draw.viewport.absMinDepth, draw.viewport.absMaxDepth);
+
+        float *zPtr = nullptr;
+        if constexpr (Spec.multiSample)
+        {
+            auto *ptr = fboDepth_->bufferMs4x->get(x, y);
+            zPtr = ptr ? &ptr->x + sample : nullptr;
+        }
+        else
+        {
+            zPtr = fboDepth_->buffer->get(x, y);
+        }
+        if (!zPtr)
+        {
+            return false;
+        }
+
+        // depth comparison
+        bool pass;
+        if constexpr (Spec.depthMode == RasterDepth_LESS)
+        {
+            pass = depth < *zPtr;
+        }
+        else if constexpr (Spec.depthMode == RasterDepth_LEQUAL)
+        {
+            pass = depth <= *zPtr;
+        }
+        else if constexpr (Spec.depthMode == RasterDepth_GREATER)
+        {
+            pass = depth > *zPtr;
+        }
+        else if constexpr (Spec.depthMode == RasterDepth_GEQUAL)
+        {
+            pass = depth >= *zPtr;
+        }
+        else
+        {
+            pass = DepthTest(depth, *zPtr, draw.renderState->depthFunc);
+        }
 
-            // depth clipping
-            if (sample.position.z < viewport_.absMinDepth ||
-                sample.position.z > viewport_.absMaxDepth)
+        // depth attachment writes
+        if constexpr (DepthWrite)
+        {
+            if (pass)
             {
-                sample.inside = false;
+                *zPtr = depth;
+                hiZWrite(x, y, depth);
             }
-
-            // barycentric correction
-            sample.barycentric *= (1.f / sample.position.w * quad.vertW);
         }
+        return pass;
     }
+}
 
-    // early z
-    if (earlyZ_ && renderState_->depthTest)
+template <RasterKernelSpec Spec>
+RGBA RendererSoft::blendSampleColor(const glm::vec4 &color, const RGBA &dst, DrawContext &draw)
+{
+    glm::vec4 srcColor = glm::clamp(color, 0.f, 1.f);
+
+    // color blending
+    if constexpr (Spec.colorMode == RasterColor_BLEND_ALPHA)
     {
-        if (!earlyZTest(quad))
-        {
-            return;
-        }
+        glm::vec4 dstColor = glm::vec4(dst) / 255.f;
+        float srcAlpha = srcColor.a;
+        srcColor = {glm::vec3(srcColor) * srcAlpha + glm::vec3(dstColor) * (1.f - srcAlpha),
+                    srcAlpha * srcAlpha + dstColor.a * (1.f - srcAlpha)};
     }
-
-    // varying interpolate
-    // note: all quad pixels should perform varying interpolate to enable varying partial derivative
-    for (auto &pixel : quad.pixels)
+    else if constexpr (Spec.colorMode == RasterColor_BLEND_GENERIC)
     {
-        interpolateBarycentric((float *)pixel.varyingsFrag, quad.vertVaryings, varyingsCnt_,
-                               pixel.sampleShading->barycentric);
+        glm::vec4 dstColor = glm::vec4(dst) / 255.f;
+        srcColor = calcBlendColor(srcColor, dstColor, draw.renderState->blendParams);
     }
+    return RGBA(srcColor * 255.f);
+}
 
-    // pixel shading
-    for (auto &pixel : quad.pixels)
+template <RasterKernelSpec Spec>
+void RendererSoft::sampleColorWrite(int x, int y, const glm::vec4 &color, DrawContext &draw)
+{
+    if constexpr (Spec.colorMode != RasterColor_NONE)
     {
-        if (!pixel.inside)
+        RGBA *ptr = fboColor_->buffer->get(x, y);
+        if (ptr)
         {
-            continue;
+            *ptr = blendSampleColor<Spec>(color, *ptr, draw);
         }
+    }
+}
 
-        // fragment shader
-        processFragmentShader(pixel.sampleShading->position, quad.frontFacing, pixel.varyingsFrag,
-                              quad.shaderProgram.get());
-
-        // sample coverage
-        auto &builtIn = quad.shaderProgram->getShaderBuiltin();
-
-        // per-sample operations
-        if (pixel.sampleCount > 1)
+template <RasterKernelSpec Spec>
+void RendererSoft::pixelColorWriteMs(int x, int y, const glm::vec4 &color, uint32_t sampleMask,
+                                     DrawContext &draw)
+{
+    if constexpr (Spec.colorMode != RasterColor_NONE)
+    {
+        auto *ptrMs = fboColor_->bufferMs4x->get(x, y);
+        if (!sampleMask || !ptrMs)
         {
-            for (int idx = 0; idx < pixel.sampleCount; idx++)
+            return;
+        }
+        RGBA *samples = (RGBA *)ptrMs;
+        uint8_t *equal = fboColor_->samplesEqual.empty()
+                             ? nullptr
+                             : &fboColor_->samplesEqual[y * fboColor_->width + x];
+
+        // fully covered, samples stay equal if they were or are all overwritten
+        constexpr uint32_t fullMask = (1u << SOFT_MS_CNT) - 1;
+        if (equal && sampleMask == fullMask)
+        {
+            if (*equal || Spec.colorMode == RasterColor_WRITE)
             {
-                auto &sample = pixel.samples[idx];
-                if (!sample.inside)
-                {
-                    continue;
-                }
-                processPerSampleOperations(sample.fboCoord.x, sample.fboCoord.y, sample.position.z,
-                                           builtIn.FragColor, idx);
+                samples[0] = blendSampleColor<Spec>(color, samples[0], draw);
+                *equal = 1;
+                return;
             }
         }
-        else
+
+        // partially covered, samples are stored separately
+        if (equal && *equal)
         {
-            auto &sample = *pixel.sampleShading;
-            processPerSampleOperations(sample.fboCoord.x, sample.fboCoord.y, sample.position.z,
-                                       builtIn.FragColor, 0);
+            *ptrMs = glm::tvec4<RGBA>(samples[0]);
+            *equal = 0;
+        }
+        for (int idx = 0; idx < SOFT_MS_CNT; idx++)
+        {
+            if (sampleMask & (1u << idx))
+            {
+                samples[idx] = blendSampleColor<Spec>(color, samples[idx], draw);
+            }
         }
     }
 }
 
-bool RendererSoft::earlyZTest(PixelQuadContext &quad)
+// average the 4 samples of each pixel with integer math, truncated like the float average
+static void resolvePixelsMs4x(RGBA *dst, const glm::tvec4<RGBA> *src, const uint8_t *samplesEqual,
+                              int pixelCnt)
 {
-    for (auto &pixel : quad.pixels)
-    {
-        if (!pixel.inside)
-        {
-            continue;
-        }
-        if (pixel.sampleCount > 1)
+    int idx = 0;
+#if defined(SOFTGL_SIMD_OPT) && defined(__AVX2__)
+    // 2 pixels per iteration, one per 128 bit lane
+    const __m256i zero = _mm256_setzero_si256();
+    for (; idx + 2 <= pixelCnt; idx += 2)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(src + idx));
+
+        // widen to 16 bits, add samples 0 + 2 and 1 + 3, then the two halves
+        __m256i sum = _mm256_add_epi16(_mm256_unpacklo_epi8(v, zero),
+                                       _mm256_unpackhi_epi8(v, zero));
+        sum = _mm256_add_epi16(sum, _mm256_srli_si256(sum, 8));
+        __m256i avg = _mm256_packus_epi16(_mm256_srli_epi16(sum, 2), zero);
+
+        uint32_t pixels[2] = {(uint32_t)_mm256_extract_epi32(avg, 0),
+                              (uint32_t)_mm256_extract_epi32(avg, 4)};
+        memcpy(dst + idx, pixels, sizeof(pixels));
+        for (int i = 0; i < 2; i++)
         {
-            bool inside = false;
-            for (int idx = 0; idx < pixel.sampleCount; idx++)
+            if (samplesEqual && samplesEqual[idx + i])
             {
-                auto &sample = pixel.samples[idx];
-                if (!sample.inside)
-                {
-                    continue;
-                }
-                sample.inside = processDepthTest(sample.fboCoord.x, sample.fboCoord.y,
-                                                 sample.position.z, idx, true);
-                if (sample.inside)
-                {
-                    inside = true;
-                }
+                dst[idx + i] = src[idx + i][0];
             }
-            pixel.inside = inside;
         }
-        else
+    }
+#endif
+    for (; idx < pixelCnt; idx++)
+    {
+        if (samplesEqual && samplesEqual[idx])
         {
-            auto &sample = *pixel.sampleShading;
-            sample.inside =
-                processDepthTest(sample.fboCoord.x, sample.fboCoord.y, sample.position.z, 0, true);
-            pixel.inside = sample.inside;
+            dst[idx] = src[idx][0];
+            continue;
+        }
+        glm::uvec4 sum(0);
+        for (int i = 0; i < SOFT_MS_CNT; i++)
+        {
+            sum += glm::uvec4(src[idx][i]);
         }
+        dst[idx] = RGBA(sum / (uint32_t)SOFT_MS_CNT);
     }
-    return quad.CheckInside();
 }
 
 void RendererSoft::multiSampleResolve()
@@ -1047,36 +2577,154 @@ void RendererSoft::multiSampleResolve()
 
     auto *srcPtr = fboColor_->bufferMs4x->getRawDataPtr();
     auto *dstPtr = fboColor_->buffer->getRawDataPtr();
+    const uint8_t *equalPtr = fboColor_->samplesEqual.empty() ? nullptr
+                                                              : fboColor_->samplesEqual.data();
 
-    for (std::size_t row = 0; row < fboColor_->height; row++)
+    // only tiles changed since the last resolve
+    const int width = fboColor_->width;
+    const int height = fboColor_->height;
+    auto resolveTiles = [&](std::size_t start, std::size_t end, std::size_t threadId)
     {
-        auto *rowSrc = srcPtr + row * fboColor_->width;
-        auto *rowDst = dstPtr + row * fboColor_->width;
-#ifdef RASTER_MULTI_THREAD
-        threadPool_.pushTask(
-            [&, rowSrc, rowDst](int thread_id)
+        for (std::size_t tileIdx = start; tileIdx < end; tileIdx++)
+        {
+            int tileX = (int)tileIdx % fboColor_->tileCntX;
+            int tileY = (int)tileIdx / fboColor_->tileCntX;
+            int x0 = tileX * SOFT_TILE_SIZE;
+            int y0 = tileY * SOFT_TILE_SIZE;
+            int x1 = std::min(x0 + SOFT_TILE_SIZE, width);
+            int y1 = std::min(y0 + SOFT_TILE_SIZE, height);
+
+            // all samples of a lazily cleared tile equal the clear value
+            if (fboColor_->isTileClearPending(tileX, tileY))
             {
-#endif
-                auto *src = rowSrc;
-                auto *dst = rowDst;
-                for (std::size_t idx = 0; idx < fboColor_->width; idx++)
+                fboColor_->buffer->setRect(x0, y0, x1, y1, fboColor_->clearValue);
+            }
+            else if (fboColor_->dirtyTiles[tileIdx])
+            {
+                for (int y = y0; y < y1; y++)
                 {
-                    glm::vec4 color(0.f);
-                    for (int i = 0; i < fboColor_->sampleCnt; i++)
-                    {
-                        color += (glm::vec4)(*src)[i];
-                    }
-                    color /= fboColor_->sampleCnt;
-                    *dst = color;
-                    src++;
-                    dst++;
+                    std::size_t offset = (std::size_t)y * width + x0;
+                    resolvePixelsMs4x(dstPtr + offset, srcPtr + offset,
+                                      equalPtr ? equalPtr + offset : nullptr, x1 - x0);
                 }
+            }
+            fboColor_->dirtyTiles[tileIdx] = 0;
+        }
+    };
+
+    const std::size_t tileCnt = (std::size_t)fboColor_->tileCntX * fboColor_->tileCntY;
+#ifdef RASTER_MULTI_THREAD
+    threadPool_.parallelFor(0, tileCnt, resolveTileGrain_, resolveTiles);
+#else
+    resolveTiles(0, tileCnt, 0);
+#endif
+}
+
+template <typename T>
+void RendererSoft::resolveClear(ImageBufferSoft<T> *image)
+{
+    if (!image || !image->clearPending)
+    {
+        return;
+    }
+
+    auto fillTiles = [&](std::size_t start, std::size_t end, std::size_t threadId)
+    {
+        for (std::size_t idx = start; idx < end; idx++)
+        {
+            image->resolveClearTile((int)idx % image->tileCntX, (int)idx / image->tileCntX);
+        }
+    };
+    const std::size_t tileCnt = (std::size_t)image->tileCntX * image->tileCntY;
 #ifdef RASTER_MULTI_THREAD
-            });
+    threadPool_.parallelFor(0, tileCnt, 4, fillTiles);
+#else
+    fillTiles(0, tileCnt, 0);
 #endif
+    image->clearPending = false;
+}
+
+void RendererSoft::hiZReset(float depth, bool dirty)
+{
+    hiZDepth_ = fboDepth_;
+    hiZTileCntX_ = (fboDepth_->width + rasterTileSize_ - 1) / rasterTileSize_;
+    hiZTileCntY_ = (fboDepth_->height + rasterTileSize_ - 1) / rasterTileSize_;
+    hiZTiles_.resize(hiZTileCntX_ * hiZTileCntY_);
+    for (auto &tile : hiZTiles_)
+    {
+        tile.minZ = depth;
+        tile.maxZ = depth;
+        tile.dirty = dirty;
+    }
+}
+
+void RendererSoft::hiZWrite(int x, int y, float depth)
+{
+    hiZWrite(x, y, depth, depth);
+}
+
+void RendererSoft::hiZWrite(int x, int y, float minZ, float maxZ)
+{
+    if (fboDepth_ != hiZDepth_)
+    {
+        return;
+    }
+
+    // expand bounds conservatively, tightened when the tile is used next time
+    HiZTile &tile = hiZTiles_[(y / rasterTileSize_) * hiZTileCntX_ + x / rasterTileSize_];
+    tile.minZ = std::min(tile.minZ, minZ);
+    tile.maxZ = std::max(tile.maxZ, maxZ);
+    tile.dirty = true;
+}
+
+void RendererSoft::hiZUpdateTile(HiZTile &tile, int tileX, int tileY)
+{
+    if (fboDepth_->isTileClearPending(tileX, tileY))
+    {
+        tile.minZ = fboDepth_->clearValue;
+        tile.maxZ = fboDepth_->clearValue;
+        tile.dirty = false;
+        return;
+    }
+
+    int startX = tileX * rasterTileSize_;
+    int startY = tileY * rasterTileSize_;
+    int endX = std::min(startX + rasterTileSize_, fboDepth_->width);
+    int endY = std::min(startY + rasterTileSize_, fboDepth_->height);
+
+    float minZ = FLT_MAX;
+    float maxZ = -FLT_MAX;
+    for (int y = startY; y < endY; y++)
+    {
+        for (int x = startX; x < endX; x++)
+        {
+            for (int sample = 0; sample < fboDepth_->sampleCnt; sample++)
+            {
+                float depth = *getFrameDepth(x, y, sample);
+                minZ = std::min(minZ, depth);
+                maxZ = std::max(maxZ, depth);
+            }
+        }
     }
 
-    threadPool_.waitTasksFinish();
+    tile.minZ = minZ;
+    tile.maxZ = maxZ;
+    tile.dirty = false;
+}
+
+bool RendererSoft::hiZTest(float minZ, float maxZ, HiZTile &tile, DepthFunction depthFunc)
+{
+    switch (depthFunc)
+    {
+    case DepthFunc_NEVER: return false;
+    case DepthFunc_LESS: return minZ < tile.maxZ;
+    case DepthFunc_LEQUAL: return minZ <= tile.maxZ;
+    case DepthFunc_GREATER: return maxZ > tile.minZ;
+    case DepthFunc_GEQUAL: return maxZ >= tile.minZ;
+    case DepthFunc_EQUAL: return minZ <= tile.maxZ && maxZ >= tile.minZ;
+    default: break;
+    }
+    return true;
 }
 
 RGBA *RendererSoft::getFrameColor(int x, int y, int sample)
@@ -1092,6 +2740,7 @@ RGBA *RendererSoft::getFrameColor(int x, int y, int sample)
         auto *ptrMs = fboColor_->bufferMs4x->get(x, y);
         if (ptrMs)
         {
+            fboColor_->splitSamples(x, y);
             ptr = (RGBA *)ptrMs + sample;
         }
     }
@@ -1135,33 +2784,191 @@ void RendererSoft::setFrameColor(int x, int y, const RGBA &color, int sample)
     }
 }
 
-std::size_t RendererSoft::clippingNewVertex(std::size_t idx0, std::size_t idx1, float t,
-                                            bool postVertexProcess)
+std::size_t RendererSoft::clippingNewVertex(std::size_t idx0, std::size_t idx1, float t)
 {
     vertexes_.emplace_back();
     VertexHolder &vh = vertexes_.back();
     vh.discard = false;
     vh.index = vertexes_.size() - 1;
     interpolateVertex(vh, vertexes_[idx0], vertexes_[idx1], t);
+    perspectiveDivideImpl(vh);
+    viewportTransformImpl(vh);
 
-    if (postVertexProcess)
+    return vh.index;
+}
+
+void RendererSoft::vertexShaderImpl(VertexHolder &vertex, ShaderProgramSoft *program,
+                                    float *scratch)
+{
+    // half varyings are written to float scratch by the shader, then packed
+    bool packHalf = varyingsHalf_ && vertex.varyings;
+    program->bindVertexAttributes(vertex.vertex);
+    program->bindVertexShaderVaryings(packHalf ? scratch : vertex.varyings);
+    program->execVertexShader();
+    if (packHalf)
     {
-        perspectiveDivideImpl(vh);
-        viewportTransformImpl(vh);
+        packHalfVaryings((uint16_t *)vertex.varyings, scratch, varyingsCnt_);
     }
 
-    return vh.index;
+    vertex.clipPos = program->getShaderBuiltin().Position;
 }
 
-void RendererSoft::vertexShaderImpl(VertexHolder &vertex)
+void RendererSoft::vertexShaderWide(VertexBlock &block, PixelQuadContext &ctx)
 {
-    shaderProgram_->bindVertexAttributes(vertex.vertex);
-    shaderProgram_->bindVertexShaderVaryings(vertex.varyings);
-    shaderProgram_->execVertexShader();
+    ShaderProgramSoft *program = ctx.shaderProgram.get();
+    const vec4x8 &position = program->getShaderBuiltin().PositionWide;
+    const auto *vertexBase = (const float *)vao_->vertexes.data();
+    const std::size_t strideCnt = vao_->vertexStride / sizeof(float);
+    float *scratch = ctx.pixels[0].varyingsFrag;
+
+    // depth only draws never read varyings
+    bool writeVaryings = varyingsCnt_ > 0 && varyings_ != nullptr;
+
+    for (int i = 0; i < block.count; i += SHADER_WIDE_LANES)
+    {
+        // attributes into lanes, lanes past the block end repeat its last vertex
+        const std::size_t *index = block.index + i;
+        int laneCnt = std::min(block.count - i, SHADER_WIDE_LANES);
+#if defined(SOFTGL_SIMD_OPT) && defined(__AVX2__)
+        alignas(32) int32_t offsets[SHADER_WIDE_LANES];
+        for (int l = 0; l < SHADER_WIDE_LANES; l++)
+        {
+            offsets[l] = (int32_t)(index[std::min(l, laneCnt - 1)] * strideCnt);
+        }
+        __m256i offset = _mm256_load_si256((const __m256i *)offsets);
+        for (std::size_t e = 0; e < attributesCnt_; e++)
+        {
+            _mm256_store_ps(ctx.attributesWide + e * SHADER_WIDE_LANES,
+                            _mm256_i32gather_ps(vertexBase + e, offset, sizeof(float)));
+        }
+#else
+        for (int l = 0; l < SHADER_WIDE_LANES; l++)
+        {
+            const float *attributes = vertexBase + index[std::min(l, laneCnt - 1)] * strideCnt;
+            for (std::size_t e = 0; e < attributesCnt_; e++)
+            {
+                ctx.attributesWide[e * SHADER_WIDE_LANES + l] = attributes[e];
+            }
+        }
+#endif
+        program->execVertexShaderWide(ctx.attributesWide, ctx.varyingsWide);
+
+        // positions are already in the SoA layout of the block
+        memcpy(block.clipX + i, &position.x, sizeof(float8));
+        memcpy(block.clipY + i, &position.y, sizeof(float8));
+        memcpy(block.clipZ + i, &position.z, sizeof(float8));
+        memcpy(block.clipW + i, &position.w, sizeof(float8));
+
+        // varyings back to one vertex per lane
+        for (int l = 0; l < laneCnt; l++)
+        {
+            VertexHolder &holder = vertexes_[index[l]];
+            holder.clipPos = glm::vec4(block.clipX[i + l], block.clipY[i + l], block.clipZ[i + l],
+                                       block.clipW[i + l]);
+            if (!writeVaryings)
+            {
+                continue;
+            }
+            float *varyings = varyingsHalf_ ? scratch : (float *)holder.varyings;
+            for (std::size_t e = 0; e < varyingsCnt_; e++)
+            {
+                varyings[e] = ctx.varyingsWide[e * SHADER_WIDE_LANES + l];
+            }
+            if (varyingsHalf_)
+            {
+                packHalfVaryings((uint16_t *)holder.varyings, scratch, varyingsCnt_);
+            }
+        }
+    }
+}
 
-    pointSize_ = shaderProgram_->getShaderBuiltin().PointSize;
-    vertex.clipPos = shaderProgram_->getShaderBuiltin().Position;
-    vertex.clipMask = countFrustumClipMask(vertex.clipPos);
+void RendererSoft::vertexPostProcessing(VertexBlock &block)
+{
+#if defined(SOFTGL_SIMD_OPT) && defined(__AVX2__)
+    // clip mask, perspective divide and viewport transform of 8 vertexes at a time,
+    // lanes past the block end are padded with a valid position and not written back
+    for (int i = block.count; i % 8 != 0; i++)
+    {
+        block.clipX[i] = 0.f;
+        block.clipY[i] = 0.f;
+        block.clipZ[i] = 0.f;
+        block.clipW[i] = 1.f;
+    }
+
+    const __m256 signMask = _mm256_set1_ps(-0.f);
+    const __m256 one = _mm256_set1_ps(1.f);
+    const __m256 scaleX = _mm256_set1_ps(viewport_.innerP.x);
+    const __m256 scaleY = _mm256_set1_ps(viewport_.innerP.y);
+    const __m256 scaleZ = _mm256_set1_ps(viewport_.innerP.z);
+    const __m256 scaleW = _mm256_set1_ps(viewport_.innerP.w);
+    const __m256 offsetX = _mm256_set1_ps(viewport_.innerO.x);
+    const __m256 offsetY = _mm256_set1_ps(viewport_.innerO.y);
+    const __m256 offsetZ = _mm256_set1_ps(viewport_.innerO.z);
+    const __m256 offsetW = _mm256_set1_ps(viewport_.innerO.w);
+
+    for (int i = 0; i < block.count; i += 8)
+    {
+        __m256 x = _mm256_load_ps(block.clipX + i);
+        __m256 y = _mm256_load_ps(block.clipY + i);
+        __m256 z = _mm256_load_ps(block.clipZ + i);
+        __m256 w = _mm256_load_ps(block.clipW + i);
+
+        // frustum clip mask, same comparisons as countFrustumClipMask
+        __m256i mask = _mm256_setzero_si256();
+        auto addMask = [&](__m256 outside, int bit)
+        {
+            mask = _mm256_or_si256(
+                mask, _mm256_and_si256(_mm256_castps_si256(outside), _mm256_set1_epi32(bit)));
+        };
+        addMask(_mm256_cmp_ps(w, x, _CMP_LT_OQ), FrustumClipMask::POSITIVE_X);
+        addMask(_mm256_cmp_ps(w, _mm256_xor_ps(x, signMask), _CMP_LT_OQ),
+                FrustumClipMask::NEGATIVE_X);
+        addMask(_mm256_cmp_ps(w, y, _CMP_LT_OQ), FrustumClipMask::POSITIVE_Y);
+        addMask(_mm256_cmp_ps(w, _mm256_xor_ps(y, signMask), _CMP_LT_OQ),
+                FrustumClipMask::NEGATIVE_Y);
+        addMask(_mm256_cmp_ps(w, z, _CMP_LT_OQ), FrustumClipMask::POSITIVE_Z);
+        addMask(_mm256_cmp_ps(w, _mm256_xor_ps(z, signMask), _CMP_LT_OQ),
+                FrustumClipMask::NEGATIVE_Z);
+        alignas(32) int32_t clipMask[8];
+        _mm256_store_si256((__m256i *)clipMask, mask);
+
+        // perspective divide, w keeps 1 / w, then viewport transform
+        __m256 invW = _mm256_div_ps(one, w);
+        __m256 fx = _mm256_fmadd_ps(_mm256_mul_ps(x, invW), scaleX, offsetX);
+        __m256 fy = _mm256_fmadd_ps(_mm256_mul_ps(y, invW), scaleY, offsetY);
+        __m256 fz = _mm256_fmadd_ps(_mm256_mul_ps(z, invW), scaleZ, offsetZ);
+        __m256 fw = _mm256_fmadd_ps(invW, scaleW, offsetW);
+
+        // back to one vec4 per vertex: lane l in the low half of pos[l % 4] for l < 4,
+        // in the high half otherwise
+        __m256 xy0 = _mm256_unpacklo_ps(fx, fy);
+        __m256 xy1 = _mm256_unpackhi_ps(fx, fy);
+        __m256 zw0 = _mm256_unpacklo_ps(fz, fw);
+        __m256 zw1 = _mm256_unpackhi_ps(fz, fw);
+        __m256 pos[4] = {_mm256_shuffle_ps(xy0, zw0, _MM_SHUFFLE(1, 0, 1, 0)),
+                         _mm256_shuffle_ps(xy0, zw0, _MM_SHUFFLE(3, 2, 3, 2)),
+                         _mm256_shuffle_ps(xy1, zw1, _MM_SHUFFLE(1, 0, 1, 0)),
+                         _mm256_shuffle_ps(xy1, zw1, _MM_SHUFFLE(3, 2, 3, 2))};
+
+        int laneCnt = std::min(8, block.count - i);
+        for (int l = 0; l < laneCnt; l++)
+        {
+            VertexHolder &holder = vertexes_[block.index[i + l]];
+            holder.clipMask = clipMask[l];
+            __m128 fragPos = l < 4 ? _mm256_castps256_ps128(pos[l])
+                                   : _mm256_extractf128_ps(pos[l - 4], 1);
+            _mm_storeu_ps(&holder.fragPos.x, fragPos);
+        }
+    }
+#else
+    for (int i = 0; i < block.count; i++)
+    {
+        VertexHolder &holder = vertexes_[block.index[i]];
+        holder.clipMask = countFrustumClipMask(holder.clipPos);
+        perspectiveDivideImpl(holder);
+        viewportTransformImpl(holder);
+    }
+#endif
 }
 
 void RendererSoft::perspectiveDivideImpl(VertexHolder &vertex)
@@ -1197,77 +3004,51 @@ int RendererSoft::countFrustumClipMask(glm::vec4 &clipPos)
     return mask;
 }
 
-BoundingBox RendererSoft::triangleBoundingBox(glm::vec4 *vert, float width, float height)
+int RendererSoft::countGuardBandClipMask(glm::vec4 &clipPos)
+{
+    int mask = 0;
+    float guardW = clipPos.w * GUARD_BAND_SCALE;
+    if (guardW < clipPos.x)
+        mask |= FrustumClipMask::POSITIVE_X;
+    if (guardW < -clipPos.x)
+        mask |= FrustumClipMask::NEGATIVE_X;
+    if (guardW < clipPos.y)
+        mask |= FrustumClipMask::POSITIVE_Y;
+    if (guardW < -clipPos.y)
+        mask |= FrustumClipMask::NEGATIVE_Y;
+    return mask;
+}
+
+BoundingBox RendererSoft::triangleBoundingBox(glm::vec4 *vert, const BoundingBox &rect)
 {
     float minX = std::min(std::min(vert[0].x, vert[1].x), vert[2].x);
     float minY = std::min(std::min(vert[0].y, vert[1].y), vert[2].y);
     float maxX = std::max(std::max(vert[0].x, vert[1].x), vert[2].x);
     float maxY = std::max(std::max(vert[0].y, vert[1].y), vert[2].y);
 
-    minX = std::max(minX - 0.5f, 0.f);
-    minY = std::max(minY - 0.5f, 0.f);
-    maxX = std::min(maxX + 0.5f, width - 1.f);
-    maxY = std::min(maxY + 0.5f, height - 1.f);
+    minX = std::max(minX - 0.5f, rect.min.x);
+    minY = std::max(minY - 0.5f, rect.min.y);
+    maxX = std::min(maxX + 0.5f, rect.max.x);
+    maxY = std::min(maxY + 0.5f, rect.max.y);
 
     auto min = glm::vec3(minX, minY, 0.f);
     auto max = glm::vec3(maxX, maxY, 0.f);
     return {min, max};
 }
 
-bool RendererSoft::barycentric(glm::aligned_vec4 *vert, glm::aligned_vec4 &v0, glm::aligned_vec4 &p,
-                               glm::aligned_vec4 &bc)
-{
-#ifdef SOFTGL_SIMD_OPT
-    // Ref: https://geometrian.com/programming/tutorials/cross-product/index.php
-    __m128 vec0 = _mm_sub_ps(_mm_load_ps(&vert[0].x), _mm_set_ps(0, p.x, v0.x, v0.x));
-    __m128 vec1 = _mm_sub_ps(_mm_load_ps(&vert[1].x), _mm_set_ps(0, p.y, v0.y, v0.y));
-
-    __m128 tmp0 = _mm_shuffle_ps(vec0, vec0, _MM_SHUFFLE(3, 0, 2, 1));
-    __m128 tmp1 = _mm_shuffle_ps(vec1, vec1, _MM_SHUFFLE(3, 1, 0, 2));
-    __m128 tmp2 = _mm_mul_ps(tmp0, vec1);
-    __m128 tmp3 = _mm_shuffle_ps(tmp2, tmp2, _MM_SHUFFLE(3, 0, 2, 1));
-    __m128 u = _mm_sub_ps(_mm_mul_ps(tmp0, tmp1), tmp3);
-
-    if (std::abs(MM_F32(u, 2)) < FLT_EPSILON)
-    {
-        return false;
-    }
-
-    u = _mm_div_ps(u, _mm_set1_ps(MM_F32(u, 2)));
-    bc = {1.f - (MM_F32(u, 0) + MM_F32(u, 1)), MM_F32(u, 1), MM_F32(u, 0), 0.f};
-#else
-    glm::vec3 u = glm::cross(glm::vec3(vert[0]) - glm::vec3(v0.x, v0.x, p.x),
-                             glm::vec3(vert[1]) - glm::vec3(v0.y, v0.y, p.y));
-    if (std::abs(u.z) < FLT_EPSILON)
-    {
-        return false;
-    }
-
-    u /= u.z;
-    bc = {1.f - (u.x + u.y), u.y, u.x, 0.f};
-#endif
-
-    if (bc.x < 0 || bc.y < 0 || bc.z < 0)
-    {
-        return false;
-    }
-
-    return true;
-}
-
 void RendererSoft::interpolateVertex(VertexHolder &out, VertexHolder &v0, VertexHolder &v1, float t)
 {
-    out.vertexHolder = MemoryUtils::makeBuffer<uint8_t>(vao_->vertexStride);
-    out.vertex = out.vertexHolder.get();
-    out.varyingsHolder = MemoryUtils::makeAlignedBuffer<float>(varyingsAlignedCnt_);
-    out.varyings = out.varyingsHolder.get();
+    out.vertex = clippingArena_.allocate<uint8_t>(vao_->vertexStride);
+    out.varyings = clippingArena_.allocate<float>(varyingsStoreCnt_);
+    float *scratch = varyingsHalf_ ? clippingArena_.allocate<float>(varyingsAlignedCnt_) : nullptr;
 
     // interpolate vertex (only support float element right now)
     const float *vertexIn[2] = {(float *)v0.vertex, (float *)v1.vertex};
     interpolateLinear((float *)out.vertex, vertexIn, vao_->vertexStride / sizeof(float), t);
 
     // vertex shader
-    vertexShaderImpl(out);
+    vertexShaderImpl(out, shaderProgram_, scratch);
+    out.clipMask = countFrustumClipMask(out.clipPos);
 }
 
 void RendererSoft::interpolateLinear(float *varsOut, const float *varsIn[2], std::size_t elemCnt,
@@ -1287,6 +3068,23 @@ void RendererSoft::interpolateLinear(float *varsOut, const float *varsIn[2], std
     }
 }
 
+void RendererSoft::interpolateLinearHalf(float *varsOut, const uint16_t *varsIn[2],
+                                         std::size_t elemCnt, float t)
+{
+    const uint16_t *inVar0 = varsIn[0];
+    const uint16_t *inVar1 = varsIn[1];
+
+    if (inVar0 == nullptr || inVar1 == nullptr)
+    {
+        return;
+    }
+
+    for (int i = 0; i < elemCnt; i++)
+    {
+        varsOut[i] = glm::mix(halfToFloat(inVar0[i]), halfToFloat(inVar1[i]), t);
+    }
+}
+
 void RendererSoft::interpolateBarycentric(float *varsOut, const float *varsIn[3],
                                           std::size_t elemCnt, glm::aligned_vec4 &bc)
 {
@@ -1373,4 +3171,96 @@ void RendererSoft::interpolateBarycentricSIMD(float *varsOut, const float *varsI
     }
 #endif
 }
+
+static inline float varyingValue(float v)
+{
+    return v;
+}
+
+static inline float varyingValue(uint16_t v)
+{
+    return halfToFloat(v);
+}
+
+template <typename T>
+void RendererSoft::interpolateBarycentricQuad(float *varsOut, const T *varsIn[3],
+                                              std::size_t elemCnt, const PixelQuadContext &quad)
+{
+    const T *inVar0 = varsIn[0];
+    const T *inVar1 = varsIn[1];
+    const T *inVar2 = varsIn[2];
+
+    if (inVar0 == nullptr || inVar1 == nullptr || inVar2 == nullptr)
+    {
+        return;
+    }
+
+    // element i of pixel p goes to varsOut[i * 4 + p], same operation order as the per pixel
+    // interpolation
+    const glm::aligned_vec4 &bcP0 = quad.pixels[0].sampleShading->barycentric;
+    const glm::aligned_vec4 &bcP1 = quad.pixels[1].sampleShading->barycentric;
+    const glm::aligned_vec4 &bcP2 = quad.pixels[2].sampleShading->barycentric;
+    const glm::aligned_vec4 &bcP3 = quad.pixels[3].sampleShading->barycentric;
+#if defined(SOFTGL_SIMD_OPT) && defined(__AVX2__)
+    __m128 bc0 = _mm_setr_ps(bcP0[0], bcP1[0], bcP2[0], bcP3[0]);
+    __m128 bc1 = _mm_setr_ps(bcP0[1], bcP1[1], bcP2[1], bcP3[1]);
+    __m128 bc2 = _mm_setr_ps(bcP0[2], bcP1[2], bcP2[2], bcP3[2]);
+    for (std::size_t idx = 0; idx < elemCnt; idx++)
+    {
+        __m128 sum = _mm_mul_ps(_mm_set1_ps(varyingValue(inVar0[idx])), bc0);
+        sum = _mm_fmadd_ps(_mm_set1_ps(varyingValue(inVar1[idx])), bc1, sum);
+        sum = _mm_fmadd_ps(_mm_set1_ps(varyingValue(inVar2[idx])), bc2, sum);
+        _mm_store_ps(varsOut + idx * 4, sum);
+    }
+#else
+    const glm::aligned_vec4 *bc[4] = {&bcP0, &bcP1, &bcP2, &bcP3};
+    for (std::size_t idx = 0; idx < elemCnt; idx++)
+    {
+        float var0 = varyingValue(inVar0[idx]);
+        float var1 = varyingValue(inVar1[idx]);
+        float var2 = varyingValue(inVar2[idx]);
+        for (int p = 0; p < 4; p++)
+        {
+            varsOut[idx * 4 + p] = var0 * (*bc[p])[0] + var1 * (*bc[p])[1] + var2 * (*bc[p])[2];
+        }
+    }
+#endif
+}
+
+void RendererSoft::interpolateBarycentricHalf(float *varsOut, const uint16_t *varsIn[3],
+                                              std::size_t elemCnt, glm::aligned_vec4 &bc)
+{
+    const uint16_t *inVar0 = varsIn[0];
+    const uint16_t *inVar1 = varsIn[1];
+    const uint16_t *inVar2 = varsIn[2];
+
+    if (inVar0 == nullptr || inVar1 == nullptr || inVar2 == nullptr)
+    {
+        return;
+    }
+
+    std::size_t idx = 0;
+#if defined(SOFTGL_SIMD_OPT) && defined(__F16C__)
+    // widen 8 halves at a time, vertex storage and output are padded to whole blocks
+    __m256 bc0 = _mm256_set1_ps(bc[0]);
+    __m256 bc1 = _mm256_set1_ps(bc[1]);
+    __m256 bc2 = _mm256_set1_ps(bc[2]);
+    for (; idx < elemCnt; idx += 8)
+    {
+        __m256 var0 = _mm256_cvtph_ps(_mm_loadu_si128((const __m128i *)(inVar0 + idx)));
+        __m256 var1 = _mm256_cvtph_ps(_mm_loadu_si128((const __m128i *)(inVar1 + idx)));
+        __m256 var2 = _mm256_cvtph_ps(_mm_loadu_si128((const __m128i *)(inVar2 + idx)));
+        __m256 sum = _mm256_mul_ps(var0, bc0);
+        sum = _mm256_fmadd_ps(var1, bc1, sum);
+        sum = _mm256_fmadd_ps(var2, bc2, sum);
+        _mm256_storeu_ps(varsOut + idx, sum);
+    }
+#endif
+
+    for (; idx < elemCnt; idx++)
+    {
+        varsOut[idx] = halfToFloat(inVar0[idx]) * bc[0] + halfToFloat(inVar1[idx]) * bc[1] +
+                       halfToFloat(inVar2[idx]) * bc[2];
+    }
+}
 } // namespace SoftGL
@@ -6,7 +6,11 @@
 
 #pragma once
 
+#include <array>
+#include <utility>
+
 #include "Base/Geometry.h"
+#include "Base/LinearAllocator.h"
 #include "Base/ThreadPool.h"
 #include "Render/Renderer.h"
 #include "Render/Software/FramebufferSoft.h"
@@ -16,9 +20,39 @@
 namespace SoftGL
 {
 
+// draw recorded with the states bound at draw() time
+struct DrawCommand
+{
+    std::shared_ptr<VertexArrayObject> vao;
+    std::shared_ptr<ShaderProgramSoft> program; // snapshot of samplers, shared between draws
+    std::shared_ptr<PipelineStates> states;
+    Viewport viewport;
+    std::size_t uniformsOffset = 0; // uniforms copied to the render pass storage
+};
+
+// render pass recorded between beginRenderPass and endRenderPass
+struct RenderPassCommand
+{
+    std::shared_ptr<FrameBuffer> frameBuffer;
+    std::shared_ptr<ImageBufferSoft<RGBA>> colorBuffer;
+    std::shared_ptr<ImageBufferSoft<float>> depthBuffer;
+    ClearStates clearStates;
+    std::vector<DrawCommand> draws;
+    std::vector<uint8_t> uniforms;
+
+    // attachments read outside the renderer, lazy clears are filled at the end of the pass
+    bool resolveColorClear = false;
+    bool resolveDepthClear = false;
+};
+
 class RendererSoft : public Renderer
 {
 public:
+    ~RendererSoft()
+    {
+        waitIdle();
+    }
+
     RendererType type() override
     {
         return Renderer_SOFT;
@@ -63,69 +97,168 @@ public:
         earlyZ_ = enable;
     };
 
+    // vertexes actually shaded by all draws of the last render pass, valid after waitIdle
+    inline std::size_t getShadedVertexCnt() const
+    {
+        return shadedVertexCnt_;
+    }
+
 private:
+    void executeRenderPasses();
+    void executeRenderPass(RenderPassCommand &pass);
+    void executeDraw(DrawCommand &cmd);
+    DrawContext &currentDrawContext();
+    void flushDrawBatch();
+
     void processVertexShader();
+    void markReferencedVertexes();
+    void processVertexShaderChunk(std::size_t start, std::size_t end, PixelQuadContext &ctx);
     void processPrimitiveAssembly();
     void processClipping();
-    void processPerspectiveDivide();
-    void processViewportTransform();
     void processFaceCulling();
+    void prepareThreadContexts();
     void processRasterization();
     void processFragmentShader(glm::vec4 &screenPos, bool frontFacing, void *varyings,
                                ShaderProgramSoft *shader);
-    void processPerSampleOperations(int x, int y, float depth, const glm::vec4 &color, int sample);
-    bool processDepthTest(int x, int y, float depth, int sample, bool skipWrite);
-    void processColorBlending(int x, int y, glm::vec4 &color, int sample);
+    void processPerSampleOperations(int x, int y, float depth, const glm::vec4 &color, int sample,
+                                    DrawContext &draw);
+    bool processDepthTest(int x, int y, float depth, int sample, bool skipWrite,
+                          DrawContext &draw);
+    void processColorBlending(int x, int y, glm::vec4 &color, int sample, DrawContext &draw);
 
     void processPointAssembly();
     void processLineAssembly();
     void processPolygonAssembly();
 
     void clippingPoint(PrimitiveHolder &point);
-    void clippingLine(PrimitiveHolder &line, bool postVertexProcess = false);
+    void clippingLine(PrimitiveHolder &line);
     void clippingTriangle(PrimitiveHolder &triangle,
                           std::vector<PrimitiveHolder> &appendPrimitives);
 
     void interpolateVertex(VertexHolder &out, VertexHolder &v0, VertexHolder &v1, float t);
     void interpolateLinear(float *varsOut, const float *varsIn[2], std::size_t elemCnt, float t);
+    void interpolateLinearHalf(float *varsOut, const uint16_t *varsIn[2], std::size_t elemCnt,
+                               float t);
     void interpolateBarycentric(float *varsOut, const float *varsIn[3], std::size_t elemCnt,
                                 glm::aligned_vec4 &bc);
     void interpolateBarycentricSIMD(float *varsOut, const float *varsIn[3], std::size_t elemCnt,
                                     glm::aligned_vec4 &bc);
+    void interpolateBarycentricHalf(float *varsOut, const uint16_t *varsIn[3],
+                                    std::size_t elemCnt, glm::aligned_vec4 &bc);
+    template <typename T>
+    void interpolateBarycentricQuad(float *varsOut, const T *varsIn[3], std::size_t elemCnt,
+                                    const PixelQuadContext &quad);
+
+    void rasterizationPoint(LineSetup &point, DrawContext &draw, PixelQuadContext &ctx,
+                            int tileX, int tileY);
+    void rasterizationLine(LineSetup &line, DrawContext &draw, PixelQuadContext &ctx, int tileX,
+                           int tileY);
+    void rasterizationLineFragment(LineSetup &line, DrawContext &draw, PixelQuadContext &ctx,
+                                   int x, int y, float t, uint32_t sampleMask);
+    void rasterizationTriangle(TriangleSetup &triangle, DrawContext &draw, PixelQuadContext &quad,
+                               int tileX, int tileY);
+    void rasterizationTriangleMicro(TriangleSetup &triangle, DrawContext &draw,
+                                    PixelQuadContext &quad);
+    void rasterizationPolygons(std::vector<PrimitiveHolder> &primitives, DrawContext &draw);
+    void rasterizationPolygonsPoint(std::vector<PrimitiveHolder> &primitives, DrawContext &draw);
+    void rasterizationPolygonsLine(std::vector<PrimitiveHolder> &primitives, DrawContext &draw);
+    void rasterizationPolygonsTriangle(std::vector<PrimitiveHolder> &primitives,
+                                       DrawContext &draw);
+    void rasterizationBatchBegin();
+    void rasterizationBatchEnd(DrawContext &draw);
+    void rasterizationTile(int tileX, int tileY, std::size_t threadId);
 
-    void rasterizationPoint(VertexHolder *v, float pointSize);
-    void rasterizationLine(VertexHolder *v0, VertexHolder *v1, float lineWidth);
-    void rasterizationTriangle(VertexHolder *v0, VertexHolder *v1, VertexHolder *v2,
-                               bool frontFacing);
-    void rasterizationPolygons(std::vector<PrimitiveHolder> &primitives);
-    void rasterizationPolygonsPoint(std::vector<PrimitiveHolder> &primitives);
-    void rasterizationPolygonsLine(std::vector<PrimitiveHolder> &primitives);
-    void rasterizationPolygonsTriangle(std::vector<PrimitiveHolder> &primitives);
-    void rasterizationPixelQuad(PixelQuadContext &quad);
-
-    bool earlyZTest(PixelQuadContext &quad);
     void multiSampleResolve();
+    template <typename T>
+    void resolveClear(ImageBufferSoft<T> *image);
+
+    // pixel quad kernels specialized at compile time, picked per draw
+    static PixelQuadKernel getPixelQuadKernel(const RasterKernelSpec &spec);
+    template <std::size_t... Keys>
+    static constexpr std::array<PixelQuadKernel, sizeof...(Keys)>
+    makePixelQuadKernels(std::index_sequence<Keys...>);
+    template <RasterKernelSpec Spec>
+    static void pixelQuadKernel(RendererSoft &renderer, PixelQuadContext &quad,
+                                TriangleSetup &triangle, DrawContext &draw);
+
+    // depth only kernels, specialized the same way
+    static DepthStepKernel getDepthStepKernel(const RasterKernelSpec &spec);
+    template <std::size_t... Keys>
+    static constexpr std::array<DepthStepKernel, sizeof...(Keys)>
+    makeDepthStepKernels(std::index_sequence<Keys...>);
+    template <RasterKernelSpec Spec>
+    static void depthStepKernel(RendererSoft &renderer, TriangleSetup &triangle, DrawContext &draw,
+                                int x, int y, int x1, uint32_t mask,
+                                const float bc[3][RASTER_LANE_MAX]);
+    template <RasterKernelSpec Spec>
+    void rasterizationDepthStep(TriangleSetup &triangle, DrawContext &draw, int x, int y, int x1,
+                                uint32_t mask, const float bc[3][RASTER_LANE_MAX]);
+
+    template <RasterKernelSpec Spec>
+    void rasterizationPixelQuad(PixelQuadContext &quad, TriangleSetup &triangle,
+                                DrawContext &draw);
+    template <RasterKernelSpec Spec>
+    bool earlyZTest(PixelQuadContext &quad, DrawContext &draw);
+    template <RasterKernelSpec Spec, bool DepthWrite>
+    bool sampleDepthTest(int x, int y, float depth, int sample, DrawContext &draw);
+    template <RasterKernelSpec Spec>
+    RGBA blendSampleColor(const glm::vec4 &color, const RGBA &dst, DrawContext &draw);
+    template <RasterKernelSpec Spec>
+    void sampleColorWrite(int x, int y, const glm::vec4 &color, DrawContext &draw);
+    template <RasterKernelSpec Spec>
+    void pixelColorWriteMs(int x, int y, const glm::vec4 &color, uint32_t sampleMask,
+                           DrawContext &draw);
 
 private:
     inline RGBA *getFrameColor(int x, int y, int sample);
     inline float *getFrameDepth(int x, int y, int sample);
     inline void setFrameColor(int x, int y, const RGBA &color, int sample);
 
-    std::size_t clippingNewVertex(std::size_t idx0, std::size_t idx1, float t,
-                                  bool postVertexProcess = false);
-    void vertexShaderImpl(VertexHolder &vertex);
+    void hiZReset(float depth, bool dirty);
+    void hiZWrite(int x, int y, float depth);
+    void hiZWrite(int x, int y, float minZ, float maxZ);
+    void hiZUpdateTile(HiZTile &tile, int tileX, int tileY);
+    bool hiZTest(float minZ, float maxZ, HiZTile &tile, DepthFunction depthFunc);
+
+    std::size_t clippingNewVertex(std::size_t idx0, std::size_t idx1, float t);
+    void vertexShaderImpl(VertexHolder &vertex, ShaderProgramSoft *program, float *scratch);
+    void vertexShaderWide(VertexBlock &block, PixelQuadContext &ctx);
+    void vertexPostProcessing(VertexBlock &block);
     void perspectiveDivideImpl(VertexHolder &vertex);
     void viewportTransformImpl(VertexHolder &vertex);
     int countFrustumClipMask(glm::vec4 &clipPos);
-    BoundingBox triangleBoundingBox(glm::vec4 *vert, float width, float height);
+    int countGuardBandClipMask(glm::vec4 &clipPos);
+    BoundingBox triangleBoundingBox(glm::vec4 *vert, const BoundingBox &rect);
+    void triangleSetup(PrimitiveHolder &triangle);
+    bool triangleSetupEdges(TriangleSetup &setup, PrimitiveHolder &triangle);
+    void lineSetup(VertexHolder *v0, VertexHolder *v1, float width, bool frontFacing);
+    void primitiveBinning(const BoundingBox &bounds, std::size_t binEntry);
 
-    bool barycentric(glm::aligned_vec4 *vert, glm::aligned_vec4 &v0, glm::aligned_vec4 &p,
-                     glm::aligned_vec4 &bc);
+    uint32_t rasterizationEdges(TriangleSetup &triangle, const int64_t edge[3], const float bary[3],
+                                const int32_t laneEdge[3][RASTER_LANE_MAX],
+                                const float laneBary[3][RASTER_LANE_MAX],
+                                float bc[3][RASTER_LANE_MAX], bool fullyCovered);
+    void rasterizationQuadSetup(PixelQuadContext &quad, int x, int y, int q, uint32_t mask,
+                                float bc[3][RASTER_LANE_MAX]);
+    void rasterizationQuadMicro(PixelQuadContext &quad, TriangleSetup &triangle, int x, int y,
+                                int q, uint32_t mask, const float bary[3]);
 
 private:
+    // recording states, only touched by the caller thread
+    std::shared_ptr<RenderPassCommand> recordPass_ = nullptr;
+    std::shared_ptr<VertexArrayObject> recordVao_ = nullptr;
+    std::shared_ptr<ShaderProgramSoft> recordProgram_ = nullptr;
+    std::shared_ptr<PipelineStates> recordStates_ = nullptr;
+    Viewport recordViewport_{};
+
+    // render passes waiting for execution, run in order by one task at a time
+    std::mutex passesMutex_;
+    std::deque<std::shared_ptr<RenderPassCommand>> pendingPasses_;
+    bool executing_ = false;
+
+    // execution states, only touched by the executing task
     Viewport viewport_{};
     PrimitiveType primitiveType_ = Primitive_TRIANGLE;
-    FrameBufferSoft *fbo_ = nullptr;
     const RenderStates *renderState_ = nullptr;
     VertexArrayObjectSoft *vao_ = nullptr;
     ShaderProgramSoft *shaderProgram_ = nullptr;
@@ -136,18 +269,63 @@ private:
     std::vector<VertexHolder> vertexes_;
     std::vector<PrimitiveHolder> primitives_;
 
+    // per draw storage of clipping output, reused between draws
+    LinearAllocator clippingArena_;
+    std::vector<PrimitiveHolder> appendPrimitives_;
+
     std::shared_ptr<float> varyings_ = nullptr;
     std::size_t varyingsCnt_ = 0;
     std::size_t varyingsAlignedCnt_ = 0;
     std::size_t varyingsAlignedSize_ = 0;
+    std::size_t varyingsStoreCnt_ = 0; // floats of storage per vertex, two halves per float
+    bool varyingsHalf_ = false;
+    bool fragmentQuad_ = false;
+
+    // vertex shader shading SHADER_WIDE_LANES vertexes per call, from attributes in lanes
+    bool vertexWide_ = false;
+    std::size_t attributesCnt_ = 0;
 
     float pointSize_ = 1.f;
     bool earlyZ_ = true;
+    PixelQuadKernel pixelQuadKernel_ = nullptr;
+    DepthStepKernel depthStepKernel_ = nullptr;
     int rasterSamples_ = 1;
-    int rasterBlockSize_ = 32;
+    int rasterTileSize_ = SOFT_TILE_SIZE; // lazy clear tiles are filled by the tile owner thread
+    int rasterBlockSize_ = 8;
+    BoundingBox rasterBounds_; // viewport pixel rect of the current draw, inclusive
+    RasterLaneLayout rasterLanes_;
+    std::size_t vertexChunkSize_ = 1024;
+    std::size_t resolveTileGrain_ = 4;
+
+    // index driven vertex shading
+    std::vector<uint8_t> vertexReferenced_;
+    std::size_t shadedVertexCnt_ = 0;
+    std::size_t lastShadedVertex_ = 0;
+
+    // sort-middle binning, each screen tile holds primitive indices in submission order,
+    // primitives of consecutive draws in a render pass are binned together and rasterized once,
+    // bin entries are indices shifted left by one, the lowest bit set for points and lines
+    int tileCntX_ = 0;
+    int tileCntY_ = 0;
+    TriangleSetupArray triangles_;
+    std::vector<LineSetup> lines_;
+    std::vector<std::vector<std::size_t>> tileBins_;
+    std::vector<std::unique_ptr<DrawContext>> drawContexts_;
+    std::size_t batchDrawCnt_ = 0;
+    std::size_t batchMaxDraws_ = 256;
+    std::size_t batchMaxPrimitives_ = 256 * 1024;
+
+    // hierarchical z, per tile depth bounds of hiZDepth_
+    int hiZTileCntX_ = 0;
+    int hiZTileCntY_ = 0;
+    std::vector<HiZTile> hiZTiles_;
+    std::shared_ptr<ImageBufferSoft<float>> hiZDepth_ = nullptr;
 
     ThreadPool threadPool_;
     std::vector<PixelQuadContext> threadQuadCtx_;
+
+    // declared last, destroyed first, waits for pending passes
+    TaskGroup executeGroup_{threadPool_};
 };
 
 } // namespace SoftGL
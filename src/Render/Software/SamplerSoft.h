@@ -459,6 +459,16 @@ class SamplerSoft
 public:
     virtual TextureType texType() = 0;
     virtual void setTexture(const std::shared_ptr<Texture> &tex) = 0;
+    virtual std::shared_ptr<SamplerSoft> clone() const = 0;
+
+    inline const std::shared_ptr<Texture> &getBoundTexture() const
+    {
+        return texture_;
+    }
+
+protected:
+    // owned reference, clones used by recorded draws keep the texture alive until executed
+    std::shared_ptr<Texture> texture_ = nullptr;
 };
 
 template <typename T>
@@ -472,6 +482,7 @@ public:
 
     void setTexture(const std::shared_ptr<Texture> &tex) override
     {
+        texture_ = tex;
         tex_ = dynamic_cast<TextureSoft<T> *>(tex.get());
         tex_->getBorderColor(sampler_.borderColor());
         sampler_.setFilterMode(tex_->getSamplerDesc().filterMin);
@@ -479,6 +490,11 @@ public:
         sampler_.setImage(&tex_->getImage());
     }
 
+    std::shared_ptr<SamplerSoft> clone() const override
+    {
+        return std::make_shared<Sampler2DSoft<T>>(*this);
+    }
+
     inline TextureSoft<T> *getTexture() const
     {
         return tex_;
@@ -520,6 +536,7 @@ public:
 
     void setTexture(const std::shared_ptr<Texture> &tex) override
     {
+        texture_ = tex;
         tex_ = dynamic_cast<TextureSoft<T> *>(tex.get());
         tex_->getBorderColor(sampler_.borderColor());
         sampler_.setFilterMode(tex_->getSamplerDesc().filterMin);
@@ -530,6 +547,11 @@ public:
         }
     }
 
+    std::shared_ptr<SamplerSoft> clone() const override
+    {
+        return std::make_shared<SamplerCubeSoft<T>>(*this);
+    }
+
     inline TextureSoft<T> *getTexture() const
     {
         return tex_;
@@ -32,6 +32,7 @@ public:
     {
         vertexShader_ = std::move(vs);
         fragmentShader_ = std::move(fs);
+        snapshot_ = nullptr; // draws recorded before keep the old shaders
 
         // defines
         auto &defineDesc = vertexShader_->getDefines();
@@ -79,6 +80,7 @@ public:
         int offset = vertexShader_->GetUniformOffset(binding);
         auto **ptr = reinterpret_cast<SamplerSoft **>(uniformBuffer_.get() + offset);
         *ptr = sampler.get();
+        samplerBindings_[binding] = sampler;
     }
 
     inline void bindVertexShaderVaryings(void *ptr)
@@ -96,6 +98,23 @@ public:
         return vertexShader_->getShaderVaryingsSize();
     }
 
+    inline std::size_t getShaderAttributesSize()
+    {
+        return vertexShader_->getShaderAttributesSize();
+    }
+
+    // store vertex shader varyings as half floats, shaders still read and write floats
+    inline void setHalfVaryings(bool enable)
+    {
+        halfVaryings_ = enable;
+        snapshot_ = nullptr;
+    }
+
+    inline bool isHalfVaryings() const
+    {
+        return halfVaryings_;
+    }
+
     inline int getUniformLocation(const std::string &name)
     {
         return vertexShader_->getUniformLocation(name);
@@ -111,6 +130,19 @@ public:
         vertexShader_->shaderMain();
     }
 
+    inline bool hasWideVertexShader() const
+    {
+        return vertexShader_->hasWideMain();
+    }
+
+    // attributes and varyings of SHADER_WIDE_LANES vertexes in float8 lanes
+    inline void execVertexShaderWide(void *attributes, void *varyings)
+    {
+        vertexShader_->bindShaderAttributesWide(attributes);
+        vertexShader_->bindShaderVaryingsWide(varyings);
+        vertexShader_->shaderMainWide();
+    }
+
     inline void prepareFragmentShader()
     {
         fragmentShader_->prepareExecMain();
@@ -122,27 +154,127 @@ public:
         fragmentShader_->shaderMain();
     }
 
-    inline std::shared_ptr<ShaderProgramSoft> clone() const
+    inline bool hasQuadFragmentShader() const
+    {
+        return fragmentShader_->hasQuadMain();
+    }
+
+    // varyings of the 4 quad pixels in float4 lanes
+    inline void execFragmentShaderQuad(void *varyings)
+    {
+        fragmentShader_->bindShaderVaryingsQuad(varyings);
+        fragmentShader_->shaderMainQuad();
+    }
+
+    inline bool fragmentShaderDiscard() const
+    {
+        return fragmentShader_->hasDiscard();
+    }
+
+    // without fragment shader the clone shares it with this program and must not execute it
+    inline std::shared_ptr<ShaderProgramSoft> clone(bool fragmentShader = true) const
     {
         auto ret = std::make_shared<ShaderProgramSoft>(*this);
+        ret->snapshot_ = nullptr;
+        ret->snapshotSamplers_.clear();
 
         ret->vertexShader_ = vertexShader_->clone();
-        ret->fragmentShader_ = fragmentShader_->clone();
         ret->vertexShader_->bindBuiltin(&ret->builtin_);
-        ret->fragmentShader_->bindBuiltin(&ret->builtin_);
+        if (fragmentShader)
+        {
+            ret->fragmentShader_ = fragmentShader_->clone();
+            ret->fragmentShader_->bindBuiltin(&ret->builtin_);
+        }
 
         return ret;
     }
 
+    // copy with its own samplers for recorded draws, shared by draws until a sampler or its
+    // texture is rebound, uniforms are copied per draw by copyUniforms
+    inline std::shared_ptr<ShaderProgramSoft> snapshot()
+    {
+        if (snapshot_ && snapshotMatches())
+        {
+            return snapshot_;
+        }
+
+        snapshot_ = clone();
+        snapshot_->uniformBuffer_ = nullptr;
+        snapshotSamplers_.clear();
+        for (auto &kv : samplerBindings_)
+        {
+            snapshot_->samplerBindings_[kv.first] = kv.second->clone();
+            snapshotSamplers_.push_back(
+                {kv.first, kv.second.get(), kv.second->getBoundTexture().get()});
+        }
+        return snapshot_;
+    }
+
+    inline std::size_t getShaderUniformsSize() const
+    {
+        return vertexShader_->getShaderUniformsSize();
+    }
+
+    // current uniforms for the last snapshot, sampler slots point to its samplers
+    inline void copyUniforms(uint8_t *dst) const
+    {
+        memcpy(dst, uniformBuffer_.get(), getShaderUniformsSize());
+        for (auto &kv : snapshot_->samplerBindings_)
+        {
+            int offset = vertexShader_->GetUniformOffset(kv.first);
+            *reinterpret_cast<SamplerSoft **>(dst + offset) = kv.second.get();
+        }
+    }
+
+    // shaders read uniforms from data, owned by the caller
+    inline void bindUniformData(uint8_t *data)
+    {
+        vertexShader_->bindShaderUniforms(data);
+        fragmentShader_->bindShaderUniforms(data);
+    }
+
+private:
+    struct SamplerBindingKey
+    {
+        int binding;
+        const SamplerSoft *sampler;
+        const Texture *texture;
+    };
+
+    inline bool snapshotMatches() const
+    {
+        if (snapshotSamplers_.size() != samplerBindings_.size())
+        {
+            return false;
+        }
+        std::size_t idx = 0;
+        for (auto &kv : samplerBindings_)
+        {
+            const SamplerBindingKey &key = snapshotSamplers_[idx++];
+            if (key.binding != kv.first || key.sampler != kv.second.get() ||
+                key.texture != kv.second->getBoundTexture().get())
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
 private:
     ShaderBuiltin builtin_;
     std::vector<std::string> defines_;
+    bool halfVaryings_ = false;
 
     std::shared_ptr<ShaderSoft> vertexShader_;
     std::shared_ptr<ShaderSoft> fragmentShader_;
 
     std::shared_ptr<uint8_t> definesBuffer_; // 0->false; 1->true
     std::shared_ptr<uint8_t> uniformBuffer_;
+    std::unordered_map<int, std::shared_ptr<SamplerSoft>> samplerBindings_;
+
+    // program for recorded draws, with the sampler bindings it was cloned from
+    std::shared_ptr<ShaderProgramSoft> snapshot_;
+    std::vector<SamplerBindingKey> snapshotSamplers_;
 
 private:
     UUID<ShaderProgramSoft> uuid_;
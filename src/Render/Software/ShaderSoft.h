@@ -9,6 +9,7 @@
 #include <functional>
 
 #include "SamplerSoft.h"
+#include "ShaderWideSoft.h"
 
 namespace SoftGL
 {
@@ -42,6 +43,9 @@ struct ShaderBuiltin
     glm::vec4 Position = glm::vec4{0.f};
     float PointSize = 1.f;
 
+    // wide vertex shader output, one lane per vertex
+    vec4x8 PositionWide;
+
     // fragment shader input
     glm::vec4 FragCoord;
     bool FrontFacing;
@@ -50,6 +54,11 @@ struct ShaderBuiltin
     glm::vec4 FragColor;
     bool discard = false;
 
+    // quad fragment shader input and output, one lane per quad pixel
+    vec4x4 FragCoordQuad;
+    vec4x4 FragColorQuad;
+    uint32_t quadMask = 0; // bit p set for pixels inside the primitive
+
     // derivative
     DerivativeContext dfCtx;
 };
@@ -65,6 +74,7 @@ public:
     virtual void bindShaderUniforms(void *ptr) = 0;
     virtual void bindShaderVaryings(void *ptr) = 0;
 
+    virtual std::size_t getShaderAttributesSize() = 0;
     virtual std::size_t getShaderUniformsSize() = 0;
     virtual std::size_t getShaderVaryingsSize() = 0;
 
@@ -162,6 +172,97 @@ public:
     {
     }
 
+    // optional vertex shader entry point shading SHADER_WIDE_LANES vertexes per call, attributes
+    // and varyings are bound as float8 lanes in the member order of the scalar structs
+    virtual bool hasWideMain() const
+    {
+        return false;
+    }
+
+    virtual void shaderMainWide()
+    {
+    }
+
+    virtual void bindShaderAttributesWide(void *ptr)
+    {
+    }
+
+    virtual void bindShaderVaryingsWide(void *ptr)
+    {
+    }
+
+    // optional fragment shader entry point shading the 4 pixels of a quad per call, varyings are
+    // bound as float4 lanes of pixels p0 p1 p2 p3, texture lods come from the lane differences
+    virtual bool hasQuadMain() const
+    {
+        return false;
+    }
+
+    virtual void shaderMainQuad()
+    {
+    }
+
+    virtual void bindShaderVaryingsQuad(void *ptr)
+    {
+    }
+
+    static inline float textureQuadLod(Sampler2DSoft<RGBA> *sampler, const vec2x4 &coord)
+    {
+        glm::vec2 texSize = glm::vec2(textureSize(sampler, 0));
+        glm::vec2 dx = (coord.lane(1) - coord.lane(0)) * texSize;
+        glm::vec2 dy = (coord.lane(2) - coord.lane(0)) * texSize;
+        float d = glm::max(glm::dot(dx, dx), glm::dot(dy, dy));
+        return glm::max(0.5f * glm::log2(d), 0.0f);
+    }
+
+    // texture lookups of the quad, lanes outside the primitive are not sampled
+    inline vec4x4 texture(Sampler2DSoft<RGBA> *sampler, const vec2x4 &coord) const
+    {
+        float lod = textureQuadLod(sampler, coord);
+        vec4x4 ret(0.f, 0.f, 0.f, 0.f);
+        for (int l = 0; l < SHADER_QUAD_LANES; l++)
+        {
+            if (gl->quadMask & (1u << l))
+            {
+                ret.setLane(l, textureLod(sampler, coord.lane(l), lod));
+            }
+        }
+        return ret;
+    }
+
+    inline vec4x4 texture(SamplerCubeSoft<RGBA> *sampler, const vec3x4 &coord) const
+    {
+        vec4x4 ret(0.f, 0.f, 0.f, 0.f);
+        for (int l = 0; l < SHADER_QUAD_LANES; l++)
+        {
+            if (gl->quadMask & (1u << l))
+            {
+                ret.setLane(l, texture(sampler, coord.lane(l)));
+            }
+        }
+        return ret;
+    }
+
+    inline vec4x4 textureLod(SamplerCubeSoft<RGBA> *sampler, const vec3x4 &coord,
+                             const float4 &lod) const
+    {
+        vec4x4 ret(0.f, 0.f, 0.f, 0.f);
+        for (int l = 0; l < SHADER_QUAD_LANES; l++)
+        {
+            if (gl->quadMask & (1u << l))
+            {
+                ret.setLane(l, textureLod(sampler, coord.lane(l), lod.lane(l)));
+            }
+        }
+        return ret;
+    }
+
+    // fragment shaders may set gl->discard unless they opt out, depth only passes skip shading then
+    virtual bool hasDiscard() const
+    {
+        return true;
+    }
+
     int getUniformLocation(const std::string &name)
     {
         auto &desc = getUniformsDesc();
@@ -217,6 +318,11 @@ public:
         v = static_cast<ShaderVaryings *>(ptr);                                                    \
     }                                                                                              \
                                                                                                    \
+    std::size_t getShaderAttributesSize() override                                                 \
+    {                                                                                              \
+        return sizeof(ShaderAttributes);                                                           \
+    }                                                                                              \
+                                                                                                   \
     std::size_t getShaderUniformsSize() override                                                   \
     {                                                                                              \
         return sizeof(ShaderUniforms);                                                             \
@@ -227,6 +333,55 @@ public:
         return sizeof(ShaderVaryings);                                                             \
     }
 
+// wide structs hold one float8 per float of the scalar structs, in the same order
+#define CREATE_SHADER_WIDE_OVERRIDE                                                                \
+    static_assert(sizeof(ShaderAttributesWide) / sizeof(float8) ==                                 \
+                  sizeof(ShaderAttributes) / sizeof(float));                                       \
+    static_assert(sizeof(ShaderVaryingsWide) / sizeof(float8) ==                                   \
+                  sizeof(ShaderVaryings) / sizeof(float));                                         \
+                                                                                                   \
+    ShaderAttributesWide *aw = nullptr;                                                            \
+    ShaderVaryingsWide *vw = nullptr;                                                              \
+                                                                                                   \
+    bool hasWideMain() const override                                                              \
+    {                                                                                              \
+        return true;                                                                               \
+    }                                                                                              \
+                                                                                                   \
+    void bindShaderAttributesWide(void *ptr) override                                              \
+    {                                                                                              \
+        aw = static_cast<ShaderAttributesWide *>(ptr);                                             \
+    }                                                                                              \
+                                                                                                   \
+    void bindShaderVaryingsWide(void *ptr) override                                                \
+    {                                                                                              \
+        vw = static_cast<ShaderVaryingsWide *>(ptr);                                               \
+    }
+
+// quad varyings hold one float4 per float of the scalar varyings, in the same order
+#define CREATE_SHADER_QUAD_OVERRIDE                                                                \
+    static_assert(sizeof(ShaderVaryingsQuad) / sizeof(float4) ==                                   \
+                  sizeof(ShaderVaryings) / sizeof(float));                                         \
+                                                                                                   \
+    ShaderVaryingsQuad *vq = nullptr;                                                              \
+                                                                                                   \
+    bool hasQuadMain() const override                                                              \
+    {                                                                                              \
+        return true;                                                                               \
+    }                                                                                              \
+                                                                                                   \
+    void bindShaderVaryingsQuad(void *ptr) override                                                \
+    {                                                                                              \
+        vq = static_cast<ShaderVaryingsQuad *>(ptr);                                               \
+    }
+
+// fragment shaders never setting gl->discard
+#define CREATE_SHADER_NO_DISCARD_OVERRIDE                                                          \
+    bool hasDiscard() const override                                                               \
+    {                                                                                              \
+        return false;                                                                              \
+    }
+
 #define CREATE_SHADER_CLONE(T)                                                                     \
     std::shared_ptr<ShaderSoft> clone() override                                                   \
     {                                                                                              \
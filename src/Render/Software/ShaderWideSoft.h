@@ -0,0 +1,472 @@
+/*
+ * SoftGLRender
+ * @author 	: keith@robot9.me
+ *
+ */
+
+#pragma once
+
+#include "Base/GLMInc.h"
+
+#if defined(SOFTGL_SIMD_OPT) && defined(__AVX2__)
+#include <immintrin.h>
+#define SOFTGL_WIDE_AVX2
+#endif
+
+namespace SoftGL
+{
+
+// vertexes shaded per wide vertex shader call
+#define SHADER_WIDE_LANES 8
+
+// pixels shaded per quad fragment shader call
+#define SHADER_QUAD_LANES 4
+
+// one float per lane, the element type of wide shader attributes and varyings
+template <int N>
+struct alignas(N * sizeof(float)) floatN
+{
+    float v[N];
+
+    floatN() = default;
+    floatN(float s)
+    {
+        for (float &f : v)
+        {
+            f = s;
+        }
+    }
+
+    inline float lane(int l) const
+    {
+        return v[l];
+    }
+
+    inline void setLane(int l, float s)
+    {
+        v[l] = s;
+    }
+
+#define FLOATN_LANE_OP(op)                                                                         \
+    friend inline floatN operator op(const floatN &a, const floatN &b)                             \
+    {                                                                                              \
+        floatN ret;                                                                                \
+        for (int l = 0; l < N; l++)                                                                \
+        {                                                                                          \
+            ret.v[l] = a.v[l] op b.v[l];                                                           \
+        }                                                                                          \
+        return ret;                                                                                \
+    }
+    FLOATN_LANE_OP(+)
+    FLOATN_LANE_OP(-)
+    FLOATN_LANE_OP(*)
+    FLOATN_LANE_OP(/)
+#undef FLOATN_LANE_OP
+
+#define FLOATN_LANE_FUNC(name, expr)                                                               \
+    friend inline floatN name(const floatN &a, const floatN &b)                                    \
+    {                                                                                              \
+        floatN ret;                                                                                \
+        for (int l = 0; l < N; l++)                                                                \
+        {                                                                                          \
+            ret.v[l] = expr;                                                                       \
+        }                                                                                          \
+        return ret;                                                                                \
+    }
+    FLOATN_LANE_FUNC(min, std::min(a.v[l], b.v[l]))
+    FLOATN_LANE_FUNC(max, std::max(a.v[l], b.v[l]))
+#undef FLOATN_LANE_FUNC
+
+    friend inline floatN sqrt(const floatN &a)
+    {
+        floatN ret;
+        for (int l = 0; l < N; l++)
+        {
+            ret.v[l] = std::sqrt(a.v[l]);
+        }
+        return ret;
+    }
+};
+
+#ifdef SOFTGL_WIDE_AVX2
+template <>
+struct alignas(32) floatN<8>
+{
+    __m256 v;
+
+    floatN() = default;
+    floatN(__m256 m)
+        : v(m)
+    {
+    }
+    floatN(float s)
+        : v(_mm256_set1_ps(s))
+    {
+    }
+
+    inline float lane(int l) const
+    {
+        return ((const float *)&v)[l];
+    }
+
+    inline void setLane(int l, float s)
+    {
+        ((float *)&v)[l] = s;
+    }
+
+    friend inline floatN operator+(const floatN &a, const floatN &b)
+    {
+        return _mm256_add_ps(a.v, b.v);
+    }
+    friend inline floatN operator-(const floatN &a, const floatN &b)
+    {
+        return _mm256_sub_ps(a.v, b.v);
+    }
+    friend inline floatN operator*(const floatN &a, const floatN &b)
+    {
+        return _mm256_mul_ps(a.v, b.v);
+    }
+    friend inline floatN operator/(const floatN &a, const floatN &b)
+    {
+        return _mm256_div_ps(a.v, b.v);
+    }
+    friend inline floatN min(const floatN &a, const floatN &b)
+    {
+        return _mm256_min_ps(a.v, b.v);
+    }
+    friend inline floatN max(const floatN &a, const floatN &b)
+    {
+        return _mm256_max_ps(a.v, b.v);
+    }
+    friend inline floatN sqrt(const floatN &a)
+    {
+        return _mm256_sqrt_ps(a.v);
+    }
+};
+
+template <>
+struct alignas(16) floatN<4>
+{
+    __m128 v;
+
+    floatN() = default;
+    floatN(__m128 m)
+        : v(m)
+    {
+    }
+    floatN(float s)
+        : v(_mm_set1_ps(s))
+    {
+    }
+
+    inline float lane(int l) const
+    {
+        return ((const float *)&v)[l];
+    }
+
+    inline void setLane(int l, float s)
+    {
+        ((float *)&v)[l] = s;
+    }
+
+    friend inline floatN operator+(const floatN &a, const floatN &b)
+    {
+        return _mm_add_ps(a.v, b.v);
+    }
+    friend inline floatN operator-(const floatN &a, const floatN &b)
+    {
+        return _mm_sub_ps(a.v, b.v);
+    }
+    friend inline floatN operator*(const floatN &a, const floatN &b)
+    {
+        return _mm_mul_ps(a.v, b.v);
+    }
+    friend inline floatN operator/(const floatN &a, const floatN &b)
+    {
+        return _mm_div_ps(a.v, b.v);
+    }
+    friend inline floatN min(const floatN &a, const floatN &b)
+    {
+        return _mm_min_ps(a.v, b.v);
+    }
+    friend inline floatN max(const floatN &a, const floatN &b)
+    {
+        return _mm_max_ps(a.v, b.v);
+    }
+    friend inline floatN sqrt(const floatN &a)
+    {
+        return _mm_sqrt_ps(a.v);
+    }
+};
+#endif
+
+using float8 = floatN<SHADER_WIDE_LANES>;
+using float4 = floatN<SHADER_QUAD_LANES>;
+
+template <int N>
+inline floatN<N> operator-(const floatN<N> &a)
+{
+    return floatN<N>(0.f) - a;
+}
+
+// scalar operands are broadcast to all lanes
+#define FLOATN_SCALAR_OP(op)                                                                       \
+    template <int N>                                                                               \
+    inline floatN<N> operator op(const floatN<N> &a, float s)                                      \
+    {                                                                                              \
+        return a op floatN<N>(s);                                                                  \
+    }                                                                                              \
+                                                                                                   \
+    template <int N>                                                                               \
+    inline floatN<N> operator op(float s, const floatN<N> &a)                                      \
+    {                                                                                              \
+        return floatN<N>(s) op a;                                                                  \
+    }
+FLOATN_SCALAR_OP(+)
+FLOATN_SCALAR_OP(-)
+FLOATN_SCALAR_OP(*)
+FLOATN_SCALAR_OP(/)
+#undef FLOATN_SCALAR_OP
+
+template <int N>
+inline floatN<N> clamp(const floatN<N> &a, float lo, float hi)
+{
+    return min(max(a, floatN<N>(lo)), floatN<N>(hi));
+}
+
+// per lane scalar function, for the transcendental ones
+template <int N, typename F>
+inline floatN<N> laneMap(const floatN<N> &a, F func)
+{
+    floatN<N> ret;
+    for (int l = 0; l < N; l++)
+    {
+        ret.setLane(l, func(a.lane(l)));
+    }
+    return ret;
+}
+
+template <int N>
+inline floatN<N> pow(const floatN<N> &a, float e)
+{
+    return laneMap(a, [e](float x) { return std::pow(x, e); });
+}
+
+template <int N>
+inline floatN<N> exp2(const floatN<N> &a)
+{
+    return laneMap(a, [](float x) { return std::exp2(x); });
+}
+
+// vectors of N lanes in SoA layout, same element order as the glm vectors they replace
+template <int N>
+struct vec2xN
+{
+    floatN<N> x, y;
+
+    inline glm::vec2 lane(int l) const
+    {
+        return {x.lane(l), y.lane(l)};
+    }
+};
+
+template <int N>
+struct vec3xN
+{
+    floatN<N> x, y, z;
+
+    vec3xN() = default;
+    vec3xN(const floatN<N> &x, const floatN<N> &y, const floatN<N> &z)
+        : x(x)
+        , y(y)
+        , z(z)
+    {
+    }
+    vec3xN(const glm::vec3 &s)
+        : x(s.x)
+        , y(s.y)
+        , z(s.z)
+    {
+    }
+
+    inline glm::vec3 lane(int l) const
+    {
+        return {x.lane(l), y.lane(l), z.lane(l)};
+    }
+
+    inline void setLane(int l, const glm::vec3 &s)
+    {
+        x.setLane(l, s.x);
+        y.setLane(l, s.y);
+        z.setLane(l, s.z);
+    }
+};
+
+template <int N>
+struct vec4xN
+{
+    floatN<N> x, y, z, w;
+
+    vec4xN() = default;
+    vec4xN(const floatN<N> &x, const floatN<N> &y, const floatN<N> &z, const floatN<N> &w)
+        : x(x)
+        , y(y)
+        , z(z)
+        , w(w)
+    {
+    }
+    vec4xN(const glm::vec4 &s)
+        : x(s.x)
+        , y(s.y)
+        , z(s.z)
+        , w(s.w)
+    {
+    }
+    vec4xN(const vec3xN<N> &v, const floatN<N> &w)
+        : x(v.x)
+        , y(v.y)
+        , z(v.z)
+        , w(w)
+    {
+    }
+
+    explicit operator vec3xN<N>() const
+    {
+        return {x, y, z};
+    }
+
+    inline glm::vec4 lane(int l) const
+    {
+        return {x.lane(l), y.lane(l), z.lane(l), w.lane(l)};
+    }
+
+    inline void setLane(int l, const glm::vec4 &s)
+    {
+        x.setLane(l, s.x);
+        y.setLane(l, s.y);
+        z.setLane(l, s.z);
+        w.setLane(l, s.w);
+    }
+};
+
+using vec2x8 = vec2xN<SHADER_WIDE_LANES>;
+using vec3x8 = vec3xN<SHADER_WIDE_LANES>;
+using vec4x8 = vec4xN<SHADER_WIDE_LANES>;
+
+using vec2x4 = vec2xN<SHADER_QUAD_LANES>;
+using vec3x4 = vec3xN<SHADER_QUAD_LANES>;
+using vec4x4 = vec4xN<SHADER_QUAD_LANES>;
+
+#define VEC3XN_OP(op)                                                                              \
+    template <int N>                                                                               \
+    inline vec3xN<N> operator op(const vec3xN<N> &a, const vec3xN<N> &b)                           \
+    {                                                                                              \
+        return {a.x op b.x, a.y op b.y, a.z op b.z};                                               \
+    }                                                                                              \
+                                                                                                   \
+    template <int N>                                                                               \
+    inline vec3xN<N> operator op(const vec3xN<N> &a, const floatN<N> &s)                           \
+    {                                                                                              \
+        return {a.x op s, a.y op s, a.z op s};                                                     \
+    }                                                                                              \
+                                                                                                   \
+    template <int N>                                                                               \
+    inline vec3xN<N> operator op(const floatN<N> &s, const vec3xN<N> &a)                           \
+    {                                                                                              \
+        return {s op a.x, s op a.y, s op a.z};                                                     \
+    }                                                                                              \
+                                                                                                   \
+    template <int N>                                                                               \
+    inline vec3xN<N> operator op(const vec3xN<N> &a, float s)                                      \
+    {                                                                                              \
+        return a op floatN<N>(s);                                                                  \
+    }                                                                                              \
+                                                                                                   \
+    template <int N>                                                                               \
+    inline vec3xN<N> operator op(float s, const vec3xN<N> &a)                                      \
+    {                                                                                              \
+        return floatN<N>(s) op a;                                                                  \
+    }
+VEC3XN_OP(+)
+VEC3XN_OP(-)
+VEC3XN_OP(*)
+VEC3XN_OP(/)
+#undef VEC3XN_OP
+
+template <int N>
+inline vec3xN<N> operator-(const vec3xN<N> &a)
+{
+    return {-a.x, -a.y, -a.z};
+}
+
+
+template <int N>
+inline floatN<N> dot(const vec3xN<N> &a, const vec3xN<N> &b)
+{
+    return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+template <int N>
+inline vec3xN<N> cross(const vec3xN<N> &a, const vec3xN<N> &b)
+{
+    return {a.y * b.z - b.y * a.z, a.z * b.x - b.z * a.x, a.x * b.y - b.x * a.y};
+}
+
+template <int N>
+inline vec3xN<N> normalize(const vec3xN<N> &a)
+{
+    floatN<N> invLen = floatN<N>(1.f) / sqrt(dot(a, a));
+    return invLen * a;
+}
+
+template <int N>
+inline vec3xN<N> reflect(const vec3xN<N> &i, const vec3xN<N> &n)
+{
+    return i - floatN<N>(2.f) * dot(n, i) * n;
+}
+
+template <int N>
+inline vec3xN<N> max(const vec3xN<N> &a, const vec3xN<N> &b)
+{
+    return {max(a.x, b.x), max(a.y, b.y), max(a.z, b.z)};
+}
+
+template <int N>
+inline vec3xN<N> mix(const vec3xN<N> &a, const vec3xN<N> &b, const floatN<N> &t)
+{
+    return a * (1.f - t) + b * t;
+}
+
+template <int N>
+inline vec3xN<N> pow(const vec3xN<N> &a, float e)
+{
+    return {pow(a.x, e), pow(a.y, e), pow(a.z, e)};
+}
+
+// column major like glm, summed in the order of glm's matrix-vector product
+template <int N>
+inline vec4xN<N> operator*(const glm::mat4 &m, const vec4xN<N> &v)
+{
+    vec4xN<N> ret;
+    floatN<N> *out = &ret.x;
+    for (int r = 0; r < 4; r++)
+    {
+        out[r] = (floatN<N>(m[0][r]) * v.x + floatN<N>(m[1][r]) * v.y) +
+                 (floatN<N>(m[2][r]) * v.z + floatN<N>(m[3][r]) * v.w);
+    }
+    return ret;
+}
+
+template <int N>
+inline vec3xN<N> operator*(const glm::mat3 &m, const vec3xN<N> &v)
+{
+    vec3xN<N> ret;
+    floatN<N> *out = &ret.x;
+    for (int r = 0; r < 3; r++)
+    {
+        out[r] = floatN<N>(m[0][r]) * v.x + floatN<N>(m[1][r]) * v.y + floatN<N>(m[2][r]) * v.z;
+    }
+    return ret;
+}
+
+} // namespace SoftGL
@@ -18,6 +18,9 @@ namespace SoftGL
 
 #define SOFT_MS_CNT 4
 
+// lazy clear and multisample resolve granularity of frame buffers, same as the raster tile size
+#define SOFT_TILE_SIZE 32
+
 template <typename T>
 class ImageBufferSoft
 {
@@ -43,6 +46,7 @@ public:
         {
             LOGE("create color buffer failed: samplers not support");
         }
+        initTiles();
     }
 
     explicit ImageBufferSoft(const std::shared_ptr<Buffer<T>> &buf)
@@ -52,6 +56,126 @@ public:
         multiSample = false;
         sampleCnt = 1;
         buffer = buf;
+        initTiles();
+    }
+
+    // only mark tiles as cleared, a tile is filled with the clear value when first used
+    void clearLazy(const T &value)
+    {
+        clearValue = value;
+        std::fill(clearTiles.begin(), clearTiles.end(), 1);
+        clearPending = true;
+    }
+
+    inline bool isTileClearPending(int tileX, int tileY) const
+    {
+        return clearPending && clearTiles[tileY * tileCntX + tileX];
+    }
+
+    // different tiles can be filled concurrently
+    void resolveClearTile(int tileX, int tileY)
+    {
+        if (!clearPending || tileX >= tileCntX || tileY >= tileCntY)
+        {
+            return;
+        }
+        uint8_t &pending = clearTiles[tileY * tileCntX + tileX];
+        if (!pending)
+        {
+            return;
+        }
+
+        int x0 = tileX * SOFT_TILE_SIZE;
+        int y0 = tileY * SOFT_TILE_SIZE;
+        int x1 = std::min(x0 + SOFT_TILE_SIZE, width);
+        int y1 = std::min(y0 + SOFT_TILE_SIZE, height);
+        if (multiSample)
+        {
+            bufferMs4x->setRect(x0, y0, x1, y1, glm::tvec4<T>(clearValue));
+            if (!samplesEqual.empty())
+            {
+                for (int y = y0; y < y1; y++)
+                {
+                    std::fill_n(&samplesEqual[y * width + x0], x1 - x0, 1);
+                }
+            }
+        }
+        else
+        {
+            buffer->setRect(x0, y0, x1, y1, clearValue);
+        }
+        pending = 0;
+    }
+
+    void resolveClear()
+    {
+        if (!clearPending)
+        {
+            return;
+        }
+        for (int tileY = 0; tileY < tileCntY; tileY++)
+        {
+            for (int tileX = 0; tileX < tileCntX; tileX++)
+            {
+                resolveClearTile(tileX, tileY);
+            }
+        }
+        clearPending = false;
+    }
+
+    // fill lazy clear and mark the tile as changed since the last multisample resolve
+    inline void beginTileWrite(int tileX, int tileY)
+    {
+        resolveClearTile(tileX, tileY);
+        if (tileX < tileCntX && tileY < tileCntY)
+        {
+            dirtyTiles[tileY * tileCntX + tileX] = 1;
+        }
+    }
+
+    // store one value per pixel while all its samples are equal, multisample only
+    void enableSamplesEqual()
+    {
+        if (multiSample && samplesEqual.empty())
+        {
+            samplesEqual.assign(width * height, 0);
+        }
+    }
+
+    // restore every sample of the pixel before they are accessed separately
+    inline void splitSamples(int x, int y)
+    {
+        if (samplesEqual.empty())
+        {
+            return;
+        }
+        uint8_t &equal = samplesEqual[y * width + x];
+        if (equal)
+        {
+            auto *ptr = bufferMs4x->get(x, y);
+            *ptr = glm::tvec4<T>((*ptr)[0]);
+            equal = 0;
+        }
+    }
+
+    void splitAllSamples()
+    {
+        for (int y = 0; y < height && !samplesEqual.empty(); y++)
+        {
+            for (int x = 0; x < width; x++)
+            {
+                splitSamples(x, y);
+            }
+        }
+    }
+
+private:
+    void initTiles()
+    {
+        tileCntX = (width + SOFT_TILE_SIZE - 1) / SOFT_TILE_SIZE;
+        tileCntY = (height + SOFT_TILE_SIZE - 1) / SOFT_TILE_SIZE;
+        clearTiles.assign(tileCntX * tileCntY, 0);
+        dirtyTiles.assign(tileCntX * tileCntY, 1);
     }
 
 public:
@@ -62,6 +186,17 @@ public:
     int height = 0;
     bool multiSample = false;
     int sampleCnt = 1;
+
+    // per tile states
+    int tileCntX = 0;
+    int tileCntY = 0;
+    std::vector<uint8_t> clearTiles; // holding the clear value only, not filled yet
+    std::vector<uint8_t> dirtyTiles; // written since the last multisample resolve
+    T clearValue{};
+    bool clearPending = false;
+
+    // per pixel, all samples equal and only the first one is up to date
+    std::vector<uint8_t> samplesEqual;
 };
 
 template <typename T>
@@ -208,6 +343,8 @@ public:
             for (int level = 0; level < layer.levels.size(); level++)
             {
                 auto &img = layer.getBuffer(level);
+                img->clearPending = false;
+                img->samplesEqual.clear();
                 if (multiSample)
                 {
                     file.read((char *)img->bufferMs4x->getRawDataPtr(),
@@ -247,6 +384,8 @@ public:
             for (int level = 0; level < layer.levels.size(); level++)
             {
                 auto &img = layer.getBuffer(level);
+                img->resolveClear();
+                img->splitAllSamples();
                 if (multiSample)
                 {
                     file.write((char *)img->bufferMs4x->getRawDataPtr(),
@@ -282,6 +421,7 @@ protected:
             return;
         }
 
+        image.getBuffer(level)->resolveClear();
         void *pixels = image.getBuffer(level)->buffer->getRawDataPtr();
         auto levelWidth = (int32_t)getLevelWidth(level);
         auto levelHeight = (int32_t)getLevelHeight(level);
@@ -6,6 +6,8 @@
 
 #pragma once
 
+#include <algorithm>
+
 #include "Base/UUID.h"
 #include "Render/Vertex.h"
 
@@ -39,6 +41,56 @@ public:
         return uuid_.get();
     }
 
+    // triangle edges (triangle * 3 + i, from vertex i to i + 1) grouped by vertex pair,
+    // built on first use
+    struct EdgeSharers
+    {
+        // edges sorted by vertex pair, equal edges are ordered by triangle
+        std::vector<uint32_t> edges;
+
+        // edge -> range [begin, end) of its sharers in edges
+        std::vector<uint32_t> begin;
+        std::vector<uint32_t> end;
+    };
+
+    const EdgeSharers &getEdgeSharers()
+    {
+        std::size_t edgeCnt = indicesCnt / 3 * 3;
+        if (edgeSharers_.edges.size() == edgeCnt)
+        {
+            return edgeSharers_;
+        }
+
+        std::vector<std::pair<uint64_t, uint32_t>> edges(edgeCnt);
+        for (std::size_t idx = 0; idx < edgeCnt; idx++)
+        {
+            auto v0 = (uint32_t)indices[idx];
+            auto v1 = (uint32_t)indices[idx % 3 == 2 ? idx - 2 : idx + 1];
+            edges[idx].first = (uint64_t)std::min(v0, v1) << 32 | std::max(v0, v1);
+            edges[idx].second = (uint32_t)idx;
+        }
+        std::sort(edges.begin(), edges.end());
+
+        edgeSharers_.edges.resize(edgeCnt);
+        edgeSharers_.begin.resize(edgeCnt);
+        edgeSharers_.end.resize(edgeCnt);
+        for (std::size_t i = 0; i < edgeCnt; i++)
+        {
+            std::size_t first = i;
+            while (i + 1 < edgeCnt && edges[i + 1].first == edges[first].first)
+            {
+                i++;
+            }
+            for (std::size_t j = first; j <= i; j++)
+            {
+                edgeSharers_.edges[j] = edges[j].second;
+                edgeSharers_.begin[edges[j].second] = (uint32_t)first;
+                edgeSharers_.end[edges[j].second] = (uint32_t)i + 1;
+            }
+        }
+        return edgeSharers_;
+    }
+
 public:
     std::size_t vertexStride = 0;
     std::size_t vertexCnt = 0;
@@ -48,6 +100,9 @@ public:
 
 private:
     UUID<VertexArrayObjectSoft> uuid_;
+
+    // indices never change after creation, vertex data updates keep the edges valid
+    EdgeSharers edgeSharers_;
 };
 
 } // namespace SoftGL
@@ -48,6 +48,8 @@ public:
     bool cullFace = true;
     bool depthTest = true;
     bool reverseZ = false;
+    bool sortDraws = true;
+    bool halfVaryings = false;
 
     glm::vec4 clearColor = {0.f, 0.f, 0.f, 0.f};
     glm::vec3 ambientColor = {0.5f, 0.5f, 0.5f};
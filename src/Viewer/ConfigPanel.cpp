@@ -208,6 +208,10 @@ void ConfigPanel::drawSettings()
     ImGui::Separator();
     ImGui::Checkbox("depth test", &config_.depthTest);
 
+    // draw order
+    ImGui::Separator();
+    ImGui::Checkbox("sort draws", &config_.sortDraws);
+
     // reverse z
     ImGui::Separator();
     if (ImGui::Checkbox("reverse z", &config_.reverseZ))
@@ -218,6 +222,19 @@ void ConfigPanel::drawSettings()
         }
     }
 
+    // half varyings
+    if (config_.rendererType == Renderer_SOFT)
+    {
+        ImGui::Separator();
+        if (ImGui::Checkbox("half varyings", &config_.halfVaryings))
+        {
+            if (resetHalfVaryingsFunc_)
+            {
+                resetHalfVaryingsFunc_();
+            }
+        }
+    }
+
     // Anti aliasing
     const char *aaItems[] = {
         "NONE",
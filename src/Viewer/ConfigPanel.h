@@ -62,6 +62,10 @@ public:
     {
         resetReverseZFunc_ = func;
     }
+    inline void setResetHalfVaryingsFunc(const std::function<void(void)> &func)
+    {
+        resetHalfVaryingsFunc_ = func;
+    }
     inline void setFrameDumpFunc(const std::function<void(void)> &func)
     {
         frameDumpFunc_ = func;
@@ -96,6 +100,7 @@ private:
     std::function<void(void)> resetCameraFunc_;
     std::function<void(void)> resetMipmapsFunc_;
     std::function<void(void)> resetReverseZFunc_;
+    std::function<void(void)> resetHalfVaryingsFunc_;
     std::function<void(void)> frameDumpFunc_;
 };
 
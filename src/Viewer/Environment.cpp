@@ -260,6 +260,9 @@ void IBLGenerator::storeToCache(std::shared_ptr<Texture> &tex)
         return;
     }
 
+    // wait for the cube faces to be rendered
+    renderer_->waitIdle();
+
     // TODO check md5
     auto cacheFilePath = getCacheFilePath(getTextureHashKey(tex));
     if (tex->format == TextureFormat_RGBA8)
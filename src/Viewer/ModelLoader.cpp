@@ -153,19 +153,17 @@ bool ModelLoader::loadSkybox(const std::string &filepath)
     {
         skyboxTex.resize(6);
 
+        const char *faceNames[6] = {"right.jpg",  "left.jpg",  "top.jpg",
+                                    "bottom.jpg", "front.jpg", "back.jpg"};
         ThreadPool pool(6);
-        pool.pushTask([&](int thread_id)
-                      { skyboxTex[0] = loadTextureFile(filepath + "right.jpg"); });
-        pool.pushTask([&](int thread_id)
-                      { skyboxTex[1] = loadTextureFile(filepath + "left.jpg"); });
-        pool.pushTask([&](int thread_id) { skyboxTex[2] = loadTextureFile(filepath + "top.jpg"); });
-        pool.pushTask([&](int thread_id)
-                      { skyboxTex[3] = loadTextureFile(filepath + "bottom.jpg"); });
-        pool.pushTask([&](int thread_id)
-                      { skyboxTex[4] = loadTextureFile(filepath + "front.jpg"); });
-        pool.pushTask([&](int thread_id)
-                      { skyboxTex[5] = loadTextureFile(filepath + "back.jpg"); });
-        pool.waitTasksFinish();
+        pool.parallelFor(0, 6, 1,
+                         [&](std::size_t start, std::size_t end, std::size_t threadId)
+                         {
+                             for (std::size_t i = start; i < end; i++)
+                             {
+                                 skyboxTex[i] = loadTextureFile(filepath + faceNames[i]);
+                             }
+                         });
 
         auto &texData = material->textureData[MaterialTexType_CUBE];
         texData.tag = filepath;
@@ -521,11 +519,16 @@ void ModelLoader::preloadTextureFiles(const aiScene *scene, const std::string &r
         return;
     }
 
-    ThreadPool pool(std::min(texPaths.size(), (std::size_t)std::thread::hardware_concurrency()));
-    for (auto &path : texPaths)
-    {
-        pool.pushTask([&](int thread_id) { loadTextureFile(path); });
-    }
+    std::vector<std::string> paths(texPaths.begin(), texPaths.end());
+    ThreadPool pool(std::min(paths.size(), (std::size_t)std::thread::hardware_concurrency()));
+    pool.parallelFor(0, paths.size(), 1,
+                     [&](std::size_t start, std::size_t end, std::size_t threadId)
+                     {
+                         for (std::size_t i = start; i < end; i++)
+                         {
+                             loadTextureFile(paths[i]);
+                         }
+                     });
 }
 
 std::shared_ptr<Buffer<RGBA>> ModelLoader::loadTextureFile(const std::string &path)
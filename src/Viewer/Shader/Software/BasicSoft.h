@@ -25,6 +25,14 @@ struct ShaderAttributes
     glm::vec3 a_tangent;
 };
 
+struct ShaderAttributesWide
+{
+    vec3x8 a_position;
+    vec2x8 a_texCoord;
+    vec3x8 a_normal;
+    vec3x8 a_tangent;
+};
+
 struct ShaderUniforms
 {
     // UniformsModel
@@ -47,6 +55,10 @@ struct ShaderVaryings
 {
 };
 
+struct ShaderVaryingsWide
+{
+};
+
 class ShaderBasic : public ShaderSoft
 {
 public:
@@ -72,18 +84,26 @@ class VS : public ShaderBasic
 {
 public:
     CREATE_SHADER_CLONE(VS)
+    CREATE_SHADER_WIDE_OVERRIDE
 
     void shaderMain() override
     {
         gl->Position = u->u_modelViewProjectionMatrix * glm::vec4(a->a_position, 1.0);
         gl->PointSize = u->u_pointSize;
     }
+
+    void shaderMainWide() override
+    {
+        gl->PositionWide = u->u_modelViewProjectionMatrix * vec4x8(aw->a_position, 1.f);
+        gl->PointSize = u->u_pointSize;
+    }
 };
 
 class FS : public ShaderBasic
 {
 public:
     CREATE_SHADER_CLONE(FS)
+    CREATE_SHADER_NO_DISCARD_OVERRIDE
 
     void shaderMain() override
     {
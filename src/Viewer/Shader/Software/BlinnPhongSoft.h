@@ -29,6 +29,14 @@ struct ShaderAttributes
     glm::vec3 a_tangent;
 };
 
+struct ShaderAttributesWide
+{
+    vec3x8 a_position;
+    vec2x8 a_texCoord;
+    vec3x8 a_normal;
+    vec3x8 a_tangent;
+};
+
 struct ShaderUniforms
 {
     // UniformsModel
@@ -73,6 +81,32 @@ struct ShaderVaryings
     glm::vec3 v_tangent;
 };
 
+struct ShaderVaryingsWide
+{
+    vec2x8 v_texCoord;
+    vec3x8 v_normalVector;
+    vec3x8 v_worldPos;
+    vec3x8 v_cameraDirection;
+    vec3x8 v_lightDirection;
+    vec4x8 v_shadowFragPos;
+
+    vec3x8 v_normal;
+    vec3x8 v_tangent;
+};
+
+struct ShaderVaryingsQuad
+{
+    vec2x4 v_texCoord;
+    vec3x4 v_normalVector;
+    vec3x4 v_worldPos;
+    vec3x4 v_cameraDirection;
+    vec3x4 v_lightDirection;
+    vec4x4 v_shadowFragPos;
+
+    vec3x4 v_normal;
+    vec3x4 v_tangent;
+};
+
 class ShaderBlinnPhong : public ShaderSoft
 {
 public:
@@ -109,6 +143,7 @@ class VS : public ShaderBlinnPhong
 {
 public:
     CREATE_SHADER_CLONE(VS)
+    CREATE_SHADER_WIDE_OVERRIDE
 
     void shaderMain() override
     {
@@ -131,12 +166,36 @@ public:
             v->v_tangent = glm::normalize(T - glm::dot(T, N) * N);
         }
     }
+
+    void shaderMainWide() override
+    {
+        vec4x8 position = vec4x8(aw->a_position, 1.f);
+        gl->PositionWide = u->u_modelViewProjectionMatrix * position;
+        vw->v_texCoord = aw->a_texCoord;
+        vw->v_shadowFragPos = u->u_shadowMVPMatrix * position;
+
+        // world space
+        vw->v_worldPos = vec3x8(u->u_modelMatrix * position);
+        vw->v_normalVector = glm::mat3(u->u_modelMatrix) * aw->a_normal;
+        vw->v_lightDirection = vec3x8(u->u_pointLightPosition) - vw->v_worldPos;
+        vw->v_cameraDirection = vec3x8(u->u_cameraPosition) - vw->v_worldPos;
+
+        if (def->NORMAL_MAP)
+        {
+            vec3x8 N = normalize(u->u_inverseTransposeModelMatrix * aw->a_normal);
+            vec3x8 T = normalize(u->u_inverseTransposeModelMatrix * aw->a_tangent);
+            vw->v_normal = N;
+            vw->v_tangent = normalize(T - dot(T, N) * N);
+        }
+    }
 };
 
 class FS : public ShaderBlinnPhong
 {
 public:
     CREATE_SHADER_CLONE(FS)
+    CREATE_SHADER_QUAD_OVERRIDE
+    CREATE_SHADER_NO_DISCARD_OVERRIDE
 
     const float depthBiasCoeff = 0.00025f;
     const float depthBiasMin = 0.00005f;
@@ -186,7 +245,26 @@ public:
         }
     }
 
-    float ShadowCalculation(glm::vec4 fragPos, glm::vec3 normal)
+    vec3x4 GetNormalFromMapQuad()
+    {
+        if (def->NORMAL_MAP)
+        {
+            vec3x4 N = normalize(vq->v_normal);
+            vec3x4 T = normalize(vq->v_tangent);
+            T = normalize(T - dot(T, N) * N);
+            vec3x4 B = cross(T, N);
+
+            // TBN * tangentNormal
+            vec3x4 tangentNormal = vec3x4(texture(u->u_normalMap, vq->v_texCoord)) * 2.0f - 1.0f;
+            return normalize(T * tangentNormal.x + B * tangentNormal.y + N * tangentNormal.z);
+        }
+        else
+        {
+            return normalize(vq->v_normalVector);
+        }
+    }
+
+    float ShadowCalculation(glm::vec4 fragPos, glm::vec3 normal, glm::vec3 lightDirection)
     {
         glm::vec3 projCoords = glm::vec3(fragPos) / fragPos.w;
         float currentDepth = projCoords.z;
@@ -196,7 +274,7 @@ public:
         }
 
         float bias = glm::max(depthBiasCoeff *
-                                  (1.0f - glm::dot(normal, glm::normalize(v->v_lightDirection))),
+                                  (1.0f - glm::dot(normal, glm::normalize(lightDirection))),
                               depthBiasMin);
         float shadow = 0.0f;
 
@@ -269,7 +347,8 @@ public:
             if (u->u_enableShadow)
             {
                 // calculate shadow
-                float shadow = 1.0f - ShadowCalculation(v->v_shadowFragPos, N);
+                float shadow =
+                    1.0f - ShadowCalculation(v->v_shadowFragPos, N, v->v_lightDirection);
                 diffuseColor *= shadow;
                 specularColor *= shadow;
             }
@@ -283,6 +362,78 @@ public:
         gl->FragColor =
             glm::vec4(ambientColor + diffuseColor + specularColor + emissiveColor, baseColor.a);
     }
+
+    void shaderMainQuad() override
+    {
+        const static float pointLightRangeInverse = 1.0f / 5.f;
+        const static float specularExponent = 128.f;
+
+        vec4x4 baseColor;
+        if (def->ALBEDO_MAP)
+        {
+            baseColor = texture(u->u_albedoMap, vq->v_texCoord);
+        }
+        else
+        {
+            baseColor = u->u_baseColor;
+        }
+
+        vec3x4 N = GetNormalFromMapQuad();
+
+        // ambient
+        float4 ao = 1.f;
+        if (def->AO_MAP)
+        {
+            ao = texture(u->u_aoMap, vq->v_texCoord).x;
+        }
+        vec3x4 ambientColor = vec3x4(baseColor) * vec3x4(u->u_ambientColor) * ao;
+        vec3x4 diffuseColor = glm::vec3(0.f);
+        vec3x4 specularColor = glm::vec3(0.f);
+        vec3x4 emissiveColor = glm::vec3(0.f);
+
+        if (u->u_enableLight)
+        {
+            // diffuse
+            vec3x4 lDir = vq->v_lightDirection * pointLightRangeInverse;
+            float4 attenuation = clamp(1.0f - dot(lDir, lDir), 0.0f, 1.0f);
+
+            vec3x4 lightDirection = normalize(vq->v_lightDirection);
+            float4 diffuse = max(dot(N, lightDirection), float4(0.0f));
+            diffuseColor = vec3x4(u->u_pointLightColor) * vec3x4(baseColor) * diffuse * attenuation;
+
+            // specular
+            vec3x4 cameraDirection = normalize(vq->v_cameraDirection);
+            vec3x4 halfVector = normalize(lightDirection + cameraDirection);
+            float4 specularAngle = max(dot(N, halfVector), float4(0.0f));
+            float4 specular = u->u_kSpecular * pow(specularAngle, specularExponent);
+            specularColor = vec3x4(specular, specular, specular);
+
+            if (u->u_enableShadow)
+            {
+                // calculate shadow, per pixel inside the primitive
+                float4 shadow = 1.0f;
+                for (int l = 0; l < SHADER_QUAD_LANES; l++)
+                {
+                    if (gl->quadMask & (1u << l))
+                    {
+                        shadow.setLane(l, 1.0f - ShadowCalculation(vq->v_shadowFragPos.lane(l),
+                                                                   N.lane(l),
+                                                                   vq->v_lightDirection.lane(l)));
+                    }
+                }
+                diffuseColor = diffuseColor * shadow;
+                specularColor = specularColor * shadow;
+            }
+        }
+
+        if (def->EMISSIVE_MAP)
+        {
+            emissiveColor = vec3x4(texture(u->u_emissiveMap, vq->v_texCoord));
+        }
+
+        gl->FragColorQuad =
+            vec4x4(ambientColor + diffuseColor + specularColor + emissiveColor, baseColor.w);
+    }
 };
 
 } // namespace ShaderBlinnPhong
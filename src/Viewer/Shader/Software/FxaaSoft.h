@@ -76,6 +76,7 @@ class FS : public ShaderFXAA
 {
 public:
     CREATE_SHADER_CLONE(FS)
+    CREATE_SHADER_NO_DISCARD_OVERRIDE
 
     // Ref: https://github.com/kosua20/Rendu/blob/master/resources/common/shaders/screens/fxaa.frag
 
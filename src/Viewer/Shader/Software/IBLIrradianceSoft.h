@@ -82,6 +82,7 @@ class FS : public ShaderIBLIrradiance
 {
 public:
     CREATE_SHADER_CLONE(FS)
+    CREATE_SHADER_NO_DISCARD_OVERRIDE
 
     void shaderMain() override
     {
@@ -87,6 +87,7 @@ class FS : public ShaderIBLPrefilter
 {
 public:
     CREATE_SHADER_CLONE(FS)
+    CREATE_SHADER_NO_DISCARD_OVERRIDE
 
     static float DistributionGGX(glm::vec3 N, glm::vec3 H, float roughness)
     {
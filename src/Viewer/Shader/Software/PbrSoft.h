@@ -30,6 +30,14 @@ struct ShaderAttributes
     glm::vec3 a_tangent;
 };
 
+struct ShaderAttributesWide
+{
+    vec3x8 a_position;
+    vec2x8 a_texCoord;
+    vec3x8 a_normal;
+    vec3x8 a_tangent;
+};
+
 struct ShaderUniforms
 {
     // UniformsModel
@@ -77,6 +85,30 @@ struct ShaderVaryings
     glm::vec3 v_tangent;
 };
 
+struct ShaderVaryingsWide
+{
+    vec2x8 v_texCoord;
+    vec3x8 v_normalVector;
+    vec3x8 v_worldPos;
+    vec3x8 v_cameraDirection;
+    vec3x8 v_lightDirection;
+
+    vec3x8 v_normal;
+    vec3x8 v_tangent;
+};
+
+struct ShaderVaryingsQuad
+{
+    vec2x4 v_texCoord;
+    vec3x4 v_normalVector;
+    vec3x4 v_worldPos;
+    vec3x4 v_cameraDirection;
+    vec3x4 v_lightDirection;
+
+    vec3x4 v_normal;
+    vec3x4 v_tangent;
+};
+
 class ShaderPbrIBL : public ShaderSoft
 {
 public:
@@ -112,6 +144,7 @@ class VS : public ShaderPbrIBL
 {
 public:
     CREATE_SHADER_CLONE(VS)
+    CREATE_SHADER_WIDE_OVERRIDE
 
     void shaderMain() override
     {
@@ -133,12 +166,35 @@ public:
             v->v_tangent = glm::normalize(T - glm::dot(T, N) * N);
         }
     }
+
+    void shaderMainWide() override
+    {
+        vec4x8 position = vec4x8(aw->a_position, 1.f);
+        gl->PositionWide = u->u_modelViewProjectionMatrix * position;
+        vw->v_texCoord = aw->a_texCoord;
+
+        // world space
+        vw->v_worldPos = vec3x8(u->u_modelMatrix * position);
+        vw->v_normalVector = glm::mat3(u->u_modelMatrix) * aw->a_normal;
+        vw->v_lightDirection = vec3x8(u->u_pointLightPosition) - vw->v_worldPos;
+        vw->v_cameraDirection = vec3x8(u->u_cameraPosition) - vw->v_worldPos;
+
+        if (def->NORMAL_MAP)
+        {
+            vec3x8 N = normalize(u->u_inverseTransposeModelMatrix * aw->a_normal);
+            vec3x8 T = normalize(u->u_inverseTransposeModelMatrix * aw->a_tangent);
+            vw->v_normal = N;
+            vw->v_tangent = normalize(T - dot(T, N) * N);
+        }
+    }
 };
 
 class FS : public ShaderPbrIBL
 {
 public:
     CREATE_SHADER_CLONE(FS)
+    CREATE_SHADER_QUAD_OVERRIDE
+    CREATE_SHADER_NO_DISCARD_OVERRIDE
 
     std::size_t getSamplerDerivativeOffset(BaseSampler<RGBA> *sampler) const override
     {
@@ -185,6 +241,25 @@ public:
         }
     }
 
+    vec3x4 GetNormalFromMapQuad()
+    {
+        if (def->NORMAL_MAP)
+        {
+            vec3x4 N = normalize(vq->v_normal);
+            vec3x4 T = normalize(vq->v_tangent);
+            T = normalize(T - dot(T, N) * N);
+            vec3x4 B = cross(T, N);
+
+            // TBN * tangentNormal
+            vec3x4 tangentNormal = vec3x4(texture(u->u_normalMap, vq->v_texCoord)) * 2.0f - 1.0f;
+            return normalize(T * tangentNormal.x + B * tangentNormal.y + N * tangentNormal.z);
+        }
+        else
+        {
+            return normalize(vq->v_normalVector);
+        }
+    }
+
     static float DistributionGGX(glm::vec3 N, glm::vec3 H, float roughness)
     {
         float a = roughness * roughness;
@@ -249,6 +324,70 @@ public:
         return SpecularColor * AB.x + AB.y;
     }
 
+    static float4 DistributionGGX(const vec3x4 &N, const vec3x4 &H, const float4 &roughness)
+    {
+        float4 a = roughness * roughness;
+        float4 a2 = a * a;
+        float4 NdotH = max(dot(N, H), float4(0.0f));
+        float4 NdotH2 = NdotH * NdotH;
+
+        float4 nom = a2;
+        float4 denom = (NdotH2 * (a2 - 1.0f) + 1.0f);
+        denom = PI * denom * denom;
+
+        return nom / denom;
+    }
+
+    static float4 GeometrySchlickGGX(const float4 &NdotV, const float4 &roughness)
+    {
+        float4 r = (roughness + 1.0f);
+        float4 k = (r * r) / 8.0f;
+
+        float4 nom = NdotV;
+        float4 denom = NdotV * (1.0f - k) + k;
+
+        return nom / denom;
+    }
+
+    static float4 GeometrySmith(const vec3x4 &N, const vec3x4 &V, const vec3x4 &L,
+                                const float4 &roughness)
+    {
+        float4 NdotV = max(dot(N, V), float4(0.0f));
+        float4 NdotL = max(dot(N, L), float4(0.0f));
+        float4 ggx2 = GeometrySchlickGGX(NdotV, roughness);
+        float4 ggx1 = GeometrySchlickGGX(NdotL, roughness);
+
+        return ggx1 * ggx2;
+    }
+
+    static vec3x4 FresnelSchlick(const float4 &cosTheta, const vec3x4 &F0)
+    {
+        return F0 + (1.0f - F0) * pow(clamp(1.0f - cosTheta, 0.0f, 1.0f), 5.0f);
+    }
+
+    static vec3x4 FresnelSchlickRoughness(const float4 &cosTheta, const vec3x4 &F0,
+                                          const float4 &roughness)
+    {
+        float4 smooth = 1.0f - roughness;
+        return F0 + (max(vec3x4(smooth, smooth, smooth), F0) - F0) *
+                        pow(clamp(1.0f - cosTheta, 0.0f, 1.0f), 5.0f);
+    }
+
+    static vec3x4 EnvBRDFApprox(const vec3x4 &SpecularColor, const float4 &Roughness,
+                                const float4 &NdotV)
+    {
+        const glm::vec4 c0 = glm::vec4(-1, -0.0275, -0.572, 0.022);
+        const glm::vec4 c1 = glm::vec4(1, 0.0425, 1.04, -0.04);
+        vec4x4 r(Roughness * c0.x + c1.x, Roughness * c0.y + c1.y, Roughness * c0.z + c1.z,
+                 Roughness * c0.w + c1.w);
+        float4 a004 = min(r.x * r.x, exp2(-9.28f * NdotV)) * r.x + r.y;
+        float4 A = -1.04f * a004 + r.z;
+        float4 B = 1.04f * a004 + r.w;
+        B = B * clamp(50.0f * SpecularColor.y, 0.f, 1.f);
+
+        return SpecularColor * A + B;
+    }
+
     void shaderMain() override
     {
         float pointLightRangeInverse = 1.0f / 5.f;
@@ -362,6 +501,118 @@ public:
 
         gl->FragColor = glm::vec4(color + emissive, albedo_rgba.a);
     }
+
+    void shaderMainQuad() override
+    {
+        float pointLightRangeInverse = 1.0f / 5.f;
+
+        vec4x4 albedo_rgba;
+        if (def->ALBEDO_MAP)
+        {
+            albedo_rgba = texture(u->u_albedoMap, vq->v_texCoord);
+        }
+        else
+        {
+            albedo_rgba = u->u_baseColor;
+        }
+
+        vec3x4 albedo = pow(vec3x4(albedo_rgba), 2.2f);
+
+        float4 metallic = 0.0f;
+        float4 roughness = 1.0f;
+        if (def->METALROUGHNESS_MAP)
+        {
+            vec4x4 metalRoughness = texture(u->u_metalRoughnessMap, vq->v_texCoord);
+            metallic = metalRoughness.z;
+            roughness = metalRoughness.y;
+        }
+
+        float4 ao = 1.f;
+        if (def->AO_MAP)
+        {
+            ao = texture(u->u_aoMap, vq->v_texCoord).x;
+        }
+
+        vec3x4 N = GetNormalFromMapQuad();
+        vec3x4 V = normalize(vq->v_cameraDirection);
+        vec3x4 R = reflect(-V, N);
+
+        vec3x4 F0 = glm::vec3(0.04f);
+        F0 = mix(F0, albedo, metallic);
+
+        // reflectance equation
+        vec3x4 Lo = glm::vec3(0.0f);
+
+        // Light begin ---------------------------------------------------------------
+        if (u->u_enableLight)
+        {
+            // calculate per-light radiance
+            vec3x4 L = normalize(vq->v_lightDirection);
+            vec3x4 H = normalize(V + L);
+
+            vec3x4 lDir = vq->v_lightDirection * pointLightRangeInverse;
+            float4 attenuation = clamp(1.0f - dot(lDir, lDir), 0.0f, 1.0f);
+            vec3x4 radiance = vec3x4(u->u_pointLightColor) * attenuation;
+
+            // Cook-Torrance BRDF
+            float4 NDF = DistributionGGX(N, H, roughness);
+            float4 G = GeometrySmith(N, V, L, roughness);
+            vec3x4 F = FresnelSchlick(max(dot(H, V), float4(0.0f)), F0);
+
+            vec3x4 numerator = NDF * G * F;
+            // + 0.0001 to prevent divide by zero
+            float4 denominator =
+                4.0f * max(dot(N, V), float4(0.0f)) * max(dot(N, L), float4(0.0f)) + 0.0001f;
+            vec3x4 specular = numerator / denominator;
+
+            vec3x4 kS = F;
+            vec3x4 kD = (1.0f - kS) * (1.0f - metallic);
+
+            float4 NdotL = max(dot(N, L), float4(0.0f));
+            Lo = Lo + (kD * albedo / PI + specular) * radiance * NdotL;
+        }
+        // Light end ---------------------------------------------------------------
+
+        // Ambient begin ---------------------------------------------------------------
+        vec3x4 ambient = glm::vec3(0.f);
+        if (u->u_enableIBL)
+        {
+            vec3x4 F = FresnelSchlickRoughness(max(dot(N, V), float4(0.0f)), F0, roughness);
+
+            vec3x4 kS = F;
+            vec3x4 kD = (1.0f - kS) * (1.0f - metallic);
+
+            vec3x4 irradiance = vec3x4(texture(u->u_irradianceMap, N));
+            vec3x4 diffuse = irradiance * albedo;
+
+            // sample both the pre-filter map and the BRDF lut and combine them together as per the
+            // Split-Sum approximation to get the IBL specular part.
+            const float MAX_REFLECTION_LOD = 4.0f;
+            vec3x4 prefilteredColor =
+                vec3x4(textureLod(u->u_prefilterMap, R, roughness * MAX_REFLECTION_LOD));
+            vec3x4 specular =
+                prefilteredColor * EnvBRDFApprox(F, roughness, max(dot(N, V), float4(0.0f)));
+            ambient = (kD * diffuse + specular) * ao;
+        }
+        else
+        {
+            ambient = vec3x4(u->u_ambientColor) * albedo * ao;
+        }
+        // Ambient end ---------------------------------------------------------------
+
+        vec3x4 color = ambient + Lo;
+        // gamma correct
+        color = pow(color, 1.0f / 2.2f);
+
+        // emissive
+        vec3x4 emissive = glm::vec3(0.f);
+        if (def->EMISSIVE_MAP)
+        {
+            emissive = vec3x4(texture(u->u_emissiveMap, vq->v_texCoord));
+        }
+
+        gl->FragColorQuad = vec4x4(color + emissive, albedo_rgba.w);
+    }
 };
 
 } // namespace ShaderPbrIBL
@@ -92,6 +92,7 @@ class FS : public ShaderSkybox
 {
 public:
     CREATE_SHADER_CLONE(FS)
+    CREATE_SHADER_NO_DISCARD_OVERRIDE
 
     static glm::vec2 SampleSphericalMap(glm::vec3 dir)
     {
@@ -375,12 +375,39 @@ void Viewer::drawScene(bool shadowPass)
 void Viewer::drawModelNodes(ModelNode &node, bool shadowPass, glm::mat4 &transform, AlphaMode mode,
                             float specular)
 {
-    glm::mat4 modelMatrix = transform * node.transform;
+    drawQueue_.clear();
+    collectModelNodes(node, transform, mode);
+
+    // opaque front to back for early depth reject, blend back to front
+    if (config_.sortDraws)
+    {
+        if (mode == Alpha_Opaque)
+        {
+            std::stable_sort(drawQueue_.begin(), drawQueue_.end(),
+                             [](const MeshDrawItem &a, const MeshDrawItem &b)
+                             { return a.depth < b.depth; });
+        }
+        else
+        {
+            std::stable_sort(drawQueue_.begin(), drawQueue_.end(),
+                             [](const MeshDrawItem &a, const MeshDrawItem &b)
+                             { return a.depth > b.depth; });
+        }
+    }
 
-    // update model uniform
-    updateUniformModel(modelMatrix, camera_->viewMatrix());
+    glm::mat4 viewMatrix = camera_->viewMatrix();
+    for (auto &item : drawQueue_)
+    {
+        updateUniformModel(item.modelMatrix, viewMatrix);
+        drawModelMesh(*item.mesh, shadowPass, specular);
+    }
+}
+
+void Viewer::collectModelNodes(ModelNode &node, const glm::mat4 &transform, AlphaMode mode)
+{
+    glm::mat4 modelMatrix = transform * node.transform;
+    glm::mat4 modelView = camera_->viewMatrix() * modelMatrix;
 
-    // draw nodes
     for (auto &mesh : node.meshes)
     {
         if (mesh.material->alphaMode != mode)
@@ -391,16 +418,23 @@ void Viewer::drawModelNodes(ModelNode &node, bool shadowPass, glm::mat4 &transfo
         // frustum cull
         if (!checkMeshFrustumCull(mesh, modelMatrix))
         {
-            return;
+            continue;
         }
 
-        drawModelMesh(mesh, shadowPass, specular);
+        // camera looks at -z in view space, opaque keys on the nearest point, blend on the center
+        BoundingBox viewBox = mesh.aabb.transform(modelView);
+        float depth = -viewBox.max.z;
+        if (mode != Alpha_Opaque)
+        {
+            depth = -(viewBox.min.z + viewBox.max.z) * 0.5f;
+        }
+        drawQueue_.push_back({&mesh, modelMatrix, depth});
     }
 
-    // draw child
+    // collect child
     for (auto &childNode : node.children)
     {
-        drawModelNodes(childNode, shadowPass, modelMatrix, mode, specular);
+        collectModelNodes(childNode, modelMatrix, mode);
     }
 }
 
@@ -657,6 +691,7 @@ void Viewer::setupSamplerUniforms(Material &material)
 bool Viewer::setupShaderProgram(Material &material, ShadingModel shading)
 {
     std::size_t cacheKey = getShaderProgramCacheKey(shading, material.shaderDefines);
+    HashUtils::hashCombine(cacheKey, config_.halfVaryings);
 
     // try cache
     auto cachedProgram = programCache_.find(cacheKey);
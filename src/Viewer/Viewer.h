@@ -70,6 +70,7 @@ private:
     void drawModelNodes(ModelNode &node, bool shadowPass, glm::mat4 &transform, AlphaMode mode,
                         float specular = 1.f);
     void drawModelMesh(ModelMesh &mesh, bool shadowPass, float specular);
+    void collectModelNodes(ModelNode &node, const glm::mat4 &transform, AlphaMode mode);
 
     void pipelineSetup(ModelBase &model, ShadingModel shading, const std::set<int> &uniformBlocks,
                        const std::function<void(RenderStates &rs)> &extraStates = nullptr);
@@ -110,6 +111,14 @@ private:
                                                     uint32_t usage, bool mipmaps = false);
     bool checkMeshFrustumCull(ModelMesh &mesh, const glm::mat4 &transform);
 
+private:
+    struct MeshDrawItem
+    {
+        ModelMesh *mesh = nullptr;
+        glm::mat4 modelMatrix{1.f};
+        float depth = 0.f; // view space distance of the aabb, nearest point or center
+    };
+
 protected:
     Config &config_;
 
@@ -148,6 +157,9 @@ protected:
     std::shared_ptr<UniformBlock> uniformBlockModel_;
     std::shared_ptr<UniformBlock> uniformBlockMaterial_;
 
+    // mesh draws of current pass
+    std::vector<MeshDrawItem> drawQueue_;
+
     // caches
     std::unordered_map<std::size_t, std::shared_ptr<ShaderProgram>> programCache_;
     std::unordered_map<std::size_t, std::shared_ptr<PipelineStates>> pipelineCache_;
@@ -83,6 +83,7 @@ public:
                 auto &viewer = viewers_[config_->rendererType];
                 viewer->resetReverseZ();
             });
+        configPanel_->setResetHalfVaryingsFunc([&]() -> void { resetStates(); });
         configPanel_->setReloadModelFunc(
             [&](const std::string &path) -> bool
             {
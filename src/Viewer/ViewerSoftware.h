@@ -38,6 +38,9 @@ public:
 
     int swapBuffer() override
     {
+        // draws are executed asynchronously, wait before reading the color buffer
+        renderer_->waitIdle();
+
         auto *texOut = dynamic_cast<TextureSoft<RGBA> *>(texColorMain_.get());
         auto buffer = texOut->getImage().getBuffer()->buffer;
         GL_CHECK(glBindTexture(GL_TEXTURE_2D, outTexId_));
@@ -60,6 +63,13 @@ public:
     bool loadShaders(ShaderProgram &program, ShadingModel shading) override
     {
         auto *programSoft = dynamic_cast<ShaderProgramSoft *>(&program);
+
+        // model shading only, image based lighting and post passes keep full precision
+        if (shading == Shading_BaseColor || shading == Shading_BlinnPhong || shading == Shading_PBR)
+        {
+            programSoft->setHalfVaryings(config_.halfVaryings);
+        }
+
         switch (shading)
         {
             CASE_CREATE_SHADER_SOFT(Shading_BaseColor, ShaderBasic);
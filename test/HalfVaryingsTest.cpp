@@ -0,0 +1,250 @@
+/*
+ * SoftGLRender
+ * @author 	: keith@robot9.me
+ *
+ */
+
+// renders one scene with float and with half varyings, fewer than 1% of the pixels may differ
+// by more than 2/255 in any channel
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+#include "Render/Software/RendererSoft.h"
+#include "Render/Software/ShaderProgramSoft.h"
+#include "Render/Software/TextureSoft.h"
+
+using namespace SoftGL;
+
+namespace ShaderHalfVaryingsTest
+{
+
+struct ShaderDefines
+{
+};
+
+struct ShaderAttributes
+{
+    glm::vec4 a_position;
+    glm::vec4 a_color;
+};
+
+struct ShaderUniforms
+{
+    glm::vec4 u_tint;
+};
+
+struct ShaderVaryings
+{
+    glm::vec4 v_color;
+    glm::vec2 v_uv;
+    glm::vec3 v_normal;
+};
+
+class ShaderHalfVaryingsTest : public ShaderSoft
+{
+public:
+    CREATE_SHADER_OVERRIDE
+
+    std::vector<std::string> &getDefines() override
+    {
+        static std::vector<std::string> defines;
+        return defines;
+    }
+
+    std::vector<UniformDesc> &getUniformsDesc() override
+    {
+        static std::vector<UniformDesc> desc = {
+            {"UniformsTest", offsetof(ShaderUniforms, u_tint)},
+        };
+        return desc;
+    };
+};
+
+class VS : public ShaderHalfVaryingsTest
+{
+public:
+    CREATE_SHADER_CLONE(VS)
+
+    void shaderMain() override
+    {
+        gl->Position = a->a_position;
+        v->v_color = a->a_color;
+        v->v_uv = glm::vec2(a->a_position.x, a->a_position.y) * 3.f;
+        v->v_normal = glm::vec3(a->a_position.x, a->a_position.y, 1.f);
+    }
+};
+
+class FS : public ShaderHalfVaryingsTest
+{
+public:
+    CREATE_SHADER_CLONE(FS)
+
+    void shaderMain() override
+    {
+        // smooth shading plus a stripe thresholded on a varying
+        glm::vec3 n = glm::normalize(v->v_normal);
+        float stripe = glm::fract(v->v_uv.x) > 0.5f ? 1.f : 0.6f;
+        glm::vec3 color = glm::vec3(v->v_color) * n.z * stripe;
+        gl->FragColor = glm::vec4(color, 1.f) * u->u_tint;
+    }
+};
+
+} // namespace ShaderHalfVaryingsTest
+
+struct TestMesh
+{
+    std::vector<float> vertexes;
+    std::vector<int32_t> indices;
+};
+
+// screen covering grid, vertex colors vary per vertex
+static TestMesh createGridMesh(int n)
+{
+    TestMesh mesh;
+    for (int y = 0; y <= n; y++)
+    {
+        for (int x = 0; x <= n; x++)
+        {
+            float px = -0.95f + 1.9f * (float)x / (float)n;
+            float py = -0.95f + 1.9f * (float)y / (float)n;
+            float vertex[8] = {px,
+                               py,
+                               0.5f + 0.3f * px * py,
+                               1.f,
+                               0.5f + 0.5f * std::sin(7.f * px),
+                               0.5f + 0.5f * std::cos(5.f * py),
+                               0.5f + 0.5f * std::sin(3.f * (px + py)),
+                               1.f};
+            mesh.vertexes.insert(mesh.vertexes.end(), vertex, vertex + 8);
+        }
+    }
+    for (int y = 0; y < n; y++)
+    {
+        for (int x = 0; x < n; x++)
+        {
+            int32_t i0 = y * (n + 1) + x;
+            int32_t i2 = i0 + n + 1;
+            int32_t quad[6] = {i0, i0 + 1, i2 + 1, i0, i2 + 1, i2};
+            mesh.indices.insert(mesh.indices.end(), quad, quad + 6);
+        }
+    }
+    return mesh;
+}
+
+static std::vector<RGBA> renderScene(RendererSoft &renderer, TestMesh &mesh, bool halfVaryings,
+                                     int width, int height)
+{
+    auto programSoft = std::dynamic_pointer_cast<ShaderProgramSoft>(renderer.createShaderProgram());
+    programSoft->SetShaders(std::make_shared<ShaderHalfVaryingsTest::VS>(),
+                            std::make_shared<ShaderHalfVaryingsTest::FS>());
+    programSoft->setHalfVaryings(halfVaryings);
+    std::shared_ptr<ShaderProgram> program = programSoft;
+
+    glm::vec4 tint(1.f, 0.95f, 0.9f, 1.f);
+    auto uniformBlock = renderer.createUniformBlock("UniformsTest", sizeof(glm::vec4));
+    uniformBlock->setData(&tint, sizeof(glm::vec4));
+    auto resources = std::make_shared<ShaderResources>();
+    resources->blocks[0] = uniformBlock;
+
+    VertexArray vertexArray;
+    const std::size_t stride = 8 * sizeof(float);
+    vertexArray.vertexSize = stride;
+    vertexArray.vertexesDesc = {{4, stride, 0}, {4, stride, 4 * sizeof(float)}};
+    vertexArray.vertexesBuffer = (uint8_t *)mesh.vertexes.data();
+    vertexArray.vertexesBufferLength = mesh.vertexes.size() * sizeof(float);
+    vertexArray.indexBuffer = mesh.indices.data();
+    vertexArray.indexBufferLength = mesh.indices.size() * sizeof(int32_t);
+    auto vao = renderer.createVertexArrayObject(vertexArray);
+
+    TextureDesc colorDesc;
+    colorDesc.width = width;
+    colorDesc.height = height;
+    colorDesc.format = TextureFormat_RGBA8;
+    colorDesc.usage = TextureUsage_AttachmentColor | TextureUsage_RendererOutput;
+    auto color = renderer.createTexture(colorDesc);
+    color->initImageData();
+
+    TextureDesc depthDesc = colorDesc;
+    depthDesc.format = TextureFormat_FLOAT32;
+    depthDesc.usage = TextureUsage_AttachmentDepth;
+    auto depth = renderer.createTexture(depthDesc);
+    depth->initImageData();
+
+    auto fbo = renderer.createFrameBuffer(true);
+    fbo->setColorAttachment(color, 0);
+    fbo->setDepthAttachment(depth);
+
+    RenderStates renderStates;
+    renderStates.depthTest = true;
+    auto pipelineStates = renderer.createPipelineStates(renderStates);
+
+    ClearStates clearStates;
+    clearStates.colorFlag = true;
+    clearStates.depthFlag = true;
+
+    renderer.beginRenderPass(fbo, clearStates);
+    renderer.setViewPort(0, 0, width, height);
+    renderer.setVertexArrayObject(vao);
+    renderer.setShaderProgram(program);
+    renderer.setShaderResources(resources);
+    renderer.setPipelineStates(pipelineStates);
+    renderer.draw();
+    renderer.endRenderPass();
+    renderer.waitIdle();
+
+    std::vector<RGBA> pixels(width * height);
+    auto buffer = dynamic_cast<TextureSoft<RGBA> *>(color.get())->getImage().getBuffer();
+    for (int y = 0; y < height; y++)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            pixels[y * width + x] = *buffer->buffer->get(x, y);
+        }
+    }
+    return pixels;
+}
+
+int main()
+{
+    const int width = 320;
+    const int height = 240;
+    const int maxChannelDiff = 2;
+    const float maxDiffRatio = 0.01f;
+
+    RendererSoft renderer;
+    renderer.create();
+
+    TestMesh mesh = createGridMesh(24);
+    std::vector<RGBA> pixelsFloat = renderScene(renderer, mesh, false, width, height);
+    std::vector<RGBA> pixelsHalf = renderScene(renderer, mesh, true, width, height);
+
+    int drawnCnt = 0;
+    int diffCnt = 0;
+    for (std::size_t i = 0; i < pixelsFloat.size(); i++)
+    {
+        const RGBA &a = pixelsFloat[i];
+        const RGBA &b = pixelsHalf[i];
+        drawnCnt += (a.r | a.g | a.b) != 0;
+        int diff = std::max({std::abs(a.r - b.r), std::abs(a.g - b.g), std::abs(a.b - b.b),
+                             std::abs(a.a - b.a)});
+        diffCnt += diff > maxChannelDiff;
+    }
+
+    float diffRatio = (float)diffCnt / (float)pixelsFloat.size();
+    printf("drawn pixels: %d, differing by more than %d/255: %d (%.3f%%)\n", drawnCnt,
+           maxChannelDiff, diffCnt, diffRatio * 100.f);
+    if (drawnCnt < (int)pixelsFloat.size() / 2)
+    {
+        printf("FAILED: scene not rendered\n");
+        return EXIT_FAILURE;
+    }
+    if (diffRatio >= maxDiffRatio)
+    {
+        printf("FAILED: half varyings differ from float varyings\n");
+        return EXIT_FAILURE;
+    }
+    printf("PASSED\n");
+    return EXIT_SUCCESS;
+}